@@ -0,0 +1,262 @@
+// bench.cpp
+// Workload benchmark for the B-tree index: times insert, search, delete and
+// mixed runs op by op and reports throughput, latency percentiles and the
+// node I/O each operation cost.
+//
+//   btree-bench [--workload insert|search|delete|mixed|all] [--n N] [--m M]
+//               [--dist seq|uniform|zipf] [--theta T] [--storage file|mmap]
+//               [--wal] [--bloom] [--deferred] [--split even|append|sequential]
+//               [--packed] [--page BYTES] [--seed S] [--file PATH]
+
+#include "btree.h"
+
+#include <cmath>
+#include <cstdio>
+
+struct BenchConfig {
+    string workload = "all";
+    int n = 100000;
+    int m = 64;
+    string dist = "uniform";
+    double theta = 0.99;          // zipfian skew
+    IndexOptions opts;
+    NodeFormat format = NodeFormat::Plain;
+    int pageBytes = 0;
+    unsigned seed = 42;
+    string file = "btree-bench.idx";
+};
+
+// Zipfian ranks in [0, n), rank 0 the most popular (Gray et al., as used by
+// YCSB). zeta(n) is computed once up front.
+class ZipfGenerator {
+public:
+    ZipfGenerator(int n, double theta) : n(n), theta(theta) {
+        for (int i = 1; i <= n; i++) zetan += 1.0 / pow((double)i, theta);
+        double zeta2 = 1.0 + 1.0 / pow(2.0, theta);
+        alpha = 1.0 / (1.0 - theta);
+        eta = (1.0 - pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta2 / zetan);
+    }
+
+    int next(mt19937_64 &rng) {
+        double u = uniform_real_distribution<double>(0.0, 1.0)(rng);
+        double uz = u * zetan;
+        if (uz < 1.0) return 0;
+        if (uz < 1.0 + pow(0.5, theta)) return min(1, n - 1);
+        return min(n - 1, (int)(n * pow(eta * u - eta + 1.0, alpha)));
+    }
+
+private:
+    int n;
+    double theta;
+    double zetan = 0, alpha = 0, eta = 0;
+};
+
+// Key positions in [0, n) for one run. Zipfian ranks are scattered over
+// the key space by a fixed permutation so the hot keys are not neighbours.
+class KeyChooser {
+public:
+    KeyChooser(const BenchConfig &cfg, mt19937_64 &rng) : dist(cfg.dist), n(cfg.n), rng(rng) {
+        if (dist == "zipf") {
+            zipf.emplace(n, cfg.theta);
+            scatter.resize(n);
+            iota(scatter.begin(), scatter.end(), 0);
+            shuffle(scatter.begin(), scatter.end(), rng);
+        }
+    }
+
+    int next() {
+        if (dist == "seq") return pos++ % n;
+        if (dist == "zipf") return scatter[zipf->next(rng)];
+        return uniform_int_distribution<int>(0, n - 1)(rng);
+    }
+
+private:
+    string dist;
+    int n;
+    mt19937_64 &rng;
+    int pos = 0;
+    optional<ZipfGenerator> zipf;
+    vector<int> scatter;
+};
+
+// Keys are odd so a lookup between two of them can never hit.
+static int keyAt(int i) { return 2 * i + 1; }
+
+struct RunResult {
+    vector<double> latencyNs;
+    double seconds = 0;
+    long long hits = 0;
+    unsigned long long reads = 0, writes = 0;
+};
+
+// Times op(i) for i in [0, ops) one call at a time. Writes left dirty in the
+// pool at the end are flushed outside the timing but counted.
+template<class Op>
+RunResult timeRun(BTreeIndex &idx, int ops, Op op) {
+    RunResult r;
+    r.latencyNs.reserve(ops);
+    unsigned long long reads0 = idx.stats().get(Counter::NodeReads), writes0 = idx.stats().get(Counter::NodeWrites);
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < ops; i++) {
+        auto t0 = chrono::steady_clock::now();
+        if (op(i)) r.hits++;
+        auto t1 = chrono::steady_clock::now();
+        r.latencyNs.push_back(chrono::duration<double, nano>(t1 - t0).count());
+    }
+    r.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    idx.flush();
+    r.reads = idx.stats().get(Counter::NodeReads) - reads0;
+    r.writes = idx.stats().get(Counter::NodeWrites) - writes0;
+    return r;
+}
+
+// Bulk-loads every key position for which want(i) holds, at 75% fill so the
+// first inserts do not all split.
+template<class Pred>
+bool preload(const BenchConfig &cfg, Pred want) {
+    vector<pair<int, int>> records;
+    for (int i = 0; i < cfg.n; i++)
+        if (want(i)) records.push_back({keyAt(i), i});
+    string file = cfg.file;
+    return BulkLoadIndexFile(file.data(), 2, cfg.m, std::move(records), 0.75, cfg.pageBytes, cfg.format);
+}
+
+static void report(const BenchConfig &cfg, const string &workload, RunResult r) {
+    vector<double> &lat = r.latencyNs;
+    size_t ops = lat.size();
+    sort(lat.begin(), lat.end());
+    auto pct = [&](double p) {
+        if (lat.empty()) return 0.0;
+        size_t i = min(lat.size() - 1, (size_t)(p / 100.0 * lat.size()));
+        return lat[i] / 1000.0;
+    };
+    double perOp = ops ? 1.0 / ops : 0.0;
+    printf("%-7s %-7s %9zu %5d %12.0f %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f %9.3f %9.3f\n",
+           workload.c_str(), cfg.dist.c_str(), ops, cfg.m,
+           r.seconds > 0 ? ops / r.seconds : 0.0,
+           pct(50), pct(90), pct(99), pct(99.9), lat.empty() ? 0.0 : lat.back() / 1000.0,
+           ops ? 100.0 * r.hits / ops : 0.0, r.reads * perOp, r.writes * perOp);
+}
+
+static bool runWorkload(const BenchConfig &cfg, const string &workload) {
+    mt19937_64 rng(cfg.seed);
+    string file = cfg.file;
+    bool ok;
+    if (workload == "insert") {
+        CreateIndexFileFile(file.data(), 2, cfg.m, cfg.pageBytes, cfg.format);
+        ok = true;
+    }
+    else if (workload == "mixed") ok = preload(cfg, [](int i) { return i % 2 == 0; });
+    else ok = preload(cfg, [](int) { return true; });
+    if (!ok) return false;
+
+    BTreeIndex idx(file.c_str(), cfg.opts);
+    if (!idx.isOpen()) return false;
+    KeyChooser keys(cfg, rng);
+    RunResult r;
+
+    if (workload == "insert") {
+        // seq inserts in key order and uniform in a random order, each key
+        // once; zipf draws keys, so repeats are rejected as duplicates.
+        vector<int> order(cfg.n);
+        iota(order.begin(), order.end(), 0);
+        if (cfg.dist == "uniform") shuffle(order.begin(), order.end(), rng);
+        else if (cfg.dist == "zipf") for (int &i : order) i = keys.next();
+        r = timeRun(idx, cfg.n, [&](int i) { return idx.insert(keyAt(order[i]), order[i]) != -1; });
+    }
+    else if (workload == "search") {
+        r = timeRun(idx, cfg.n, [&](int) { return idx.search(keyAt(keys.next())) != -1; });
+    }
+    else if (workload == "delete") {
+        vector<int> order(cfg.n);
+        iota(order.begin(), order.end(), 0);
+        if (cfg.dist == "uniform") shuffle(order.begin(), order.end(), rng);
+        else if (cfg.dist == "zipf") for (int &i : order) i = keys.next();
+        r = timeRun(idx, cfg.n, [&](int i) { return idx.erase(keyAt(order[i])); });
+    }
+    else {
+        // 50% search, 25% insert, 25% delete over a half-full key space.
+        r = timeRun(idx, cfg.n, [&](int) {
+            int k = keys.next();
+            unsigned kind = rng() % 4;
+            if (kind < 2) return idx.search(keyAt(k)) != -1;
+            if (kind == 2) return idx.insert(keyAt(k), k) != -1;
+            return idx.erase(keyAt(k));
+        });
+    }
+    report(cfg, workload, std::move(r));
+    return true;
+}
+
+static void usage() {
+    cerr << "usage: btree-bench [--workload insert|search|delete|mixed|all] [--n N] [--m M]\n"
+            "                   [--dist seq|uniform|zipf] [--theta T] [--storage file|mmap]\n"
+            "                   [--wal] [--bloom] [--deferred] [--split even|append|sequential]\n"
+            "                   [--packed] [--page BYTES] [--seed S] [--file PATH]\n";
+}
+
+int main(int argc, char **argv) {
+    BenchConfig cfg;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        auto value = [&]() -> string {
+            if (i + 1 >= argc) {
+                usage();
+                exit(2);
+            }
+            return argv[++i];
+        };
+        if (arg == "--workload") cfg.workload = value();
+        else if (arg == "--n") cfg.n = stoi(value());
+        else if (arg == "--m") cfg.m = stoi(value());
+        else if (arg == "--dist") cfg.dist = value();
+        else if (arg == "--theta") cfg.theta = stod(value());
+        else if (arg == "--storage") cfg.opts.storage = value() == "mmap" ? StorageMode::Mmap : StorageMode::File;
+        else if (arg == "--wal") cfg.opts.writeAheadLog = true;
+        else if (arg == "--bloom") cfg.opts.bloomFilter = true;
+        else if (arg == "--deferred") cfg.opts.deferredDeletes = true;
+        else if (arg == "--split") {
+            string policy = value();
+            if (policy == "even") cfg.opts.split = SplitPolicy::Even;
+            else if (policy == "append") cfg.opts.split = SplitPolicy::Append;
+            else if (policy == "sequential") cfg.opts.split = SplitPolicy::Sequential;
+            else {
+                usage();
+                return 2;
+            }
+        }
+        else if (arg == "--packed") cfg.format = NodeFormat::Packed;
+        else if (arg == "--page") cfg.pageBytes = stoi(value());
+        else if (arg == "--seed") cfg.seed = stoul(value());
+        else if (arg == "--file") cfg.file = value();
+        else {
+            usage();
+            return 2;
+        }
+    }
+    vector<string> workloads = {"insert", "search", "delete", "mixed"};
+    if (cfg.workload != "all") workloads = {cfg.workload};
+    bool valid = cfg.n > 0 && cfg.m >= MIN_ORDER && cfg.theta > 0 && cfg.theta != 1.0 &&
+                 (cfg.dist == "seq" || cfg.dist == "uniform" || cfg.dist == "zipf");
+    for (const string &w : workloads)
+        valid = valid && (w == "insert" || w == "search" || w == "delete" || w == "mixed");
+    if (!valid) {
+        usage();
+        return 2;
+    }
+
+    printf("%-7s %-7s %9s %5s %12s %9s %9s %9s %9s %9s %9s %9s %9s\n", "work", "dist", "ops", "m", "ops/s",
+           "p50us", "p90us", "p99us", "p999us", "maxus", "hit%", "reads/op", "writes/op");
+    int status = 0;
+    for (const string &w : workloads) {
+        if (!runWorkload(cfg, w)) {
+            cerr << "cannot create " << cfg.file << "\n";
+            status = 1;
+            break;
+        }
+    }
+    filesystem::remove(cfg.file);
+    filesystem::remove(cfg.file + ".wal");
+    filesystem::remove(cfg.file + ".bloom");
+    return status;
+}
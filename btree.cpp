@@ -0,0 +1,628 @@
+// btree.cpp
+// Non-template parts of the index library: the file header and free list,
+// file growth, statistics, storage, WAL, Bloom filter, async I/O and
+// shadow paging, plus the BTREE_INSTANTIATE instantiations for int and
+// long long keys.
+
+#include "btree_impl.h"
+
+BTREE_INSTANTIATE(template, int, int)
+BTREE_INSTANTIATE(template, long long, long long)
+
+// ---------------- FILE HEADER ----------------
+
+// The header as it sits at the start of slot 0's image
+FileHeader& headerIn(char *image) {
+    return *reinterpret_cast<FileHeader*>(image);
+}
+
+// Value ranges of a packed node: each key and ref is stored as its offset
+// from the smallest one, in just enough bits for the largest offset.
+struct PackedShape {
+    bool leaf;
+    int count = 0;
+    long long keyLo = LLONG_MAX, keyHi = LLONG_MIN;
+    long long refLo = LLONG_MAX, refHi = LLONG_MIN;
+
+    void add(int key, int ref) {
+        count++;
+        keyLo = min<long long>(keyLo, key);
+        keyHi = max<long long>(keyHi, key);
+        refLo = min<long long>(refLo, ref);
+        refHi = max<long long>(refHi, ref);
+    }
+    static int bitsFor(unsigned long long range) { return range ? 64 - __builtin_clzll(range) : 0; }
+    long long keyBase() const { return leaf && count ? keyLo : 0; }
+    long long refBase() const { return count ? refLo : 0; }
+    int keyBits() const { return leaf ? (count ? bitsFor(keyHi - keyLo) : 0) : 32; }
+    int refBits() const { return count ? bitsFor(refHi - refLo) : 0; }
+    long long bytes() const {
+        long long bits = (long long)count * (keyBits() + refBits());
+        return PACKED_HEADER_BYTES + (bits + 63) / 64 * 8;
+    }
+};
+
+static PackedShape shapeOf(const Node &n) {
+    PackedShape s{n.flag == 0};
+    for (int i = 0; i < n.count; i++) s.add(n.key[i], n.ref[i]);
+    return s;
+}
+
+long long packedBytes(const Node &n) {
+    return shapeOf(n).bytes();
+}
+
+long long packedBytes(const Node &n, int key, int ref) {
+    PackedShape s = shapeOf(n);
+    s.add(key, ref);
+    return s.bytes();
+}
+
+// Bit fields in little-endian 64-bit words; a field may straddle two.
+static void putBits(char *words, long long pos, int bits, unsigned long long v) {
+    if (bits == 0) return;
+    for (int done = 0; done < bits;) {
+        long long w = (pos + done) / 64;
+        int shift = (int)((pos + done) % 64);
+        int take = min(bits - done, 64 - shift);
+        unsigned long long word;
+        memcpy(&word, words + w * 8, 8);
+        unsigned long long mask = (take == 64 ? ~0ULL : ((1ULL << take) - 1)) << shift;
+        word = (word & ~mask) | (((v >> done) << shift) & mask);
+        memcpy(words + w * 8, &word, 8);
+        done += take;
+    }
+}
+
+// Fields are at most 32 bits, so one unaligned 8-byte load covers any of
+// them; 'len' bounds the load near the end of the buffer.
+static unsigned long long getBits(const char *words, long long len, long long pos, int bits) {
+    if (bits == 0) return 0;
+    long long byte = pos / 8;
+    unsigned long long word = 0;
+    memcpy(&word, words + byte, (size_t)min(8LL, len - byte));
+    return (word >> (pos % 8)) & ((1ULL << bits) - 1);
+}
+
+void packImage(const char *image, int m, char *slot, long long slotLen) {
+    NodeView<int, int> n{image, m};
+    int flag = n.flag();
+    PackedShape s{flag == 0};
+    if (flag != -1)
+        for (int i = 0; i < n.count(); i++) s.add(n.key(i), n.ref(i));
+    int kb = s.keyBits(), rb = s.refBits();
+    int head[6] = {flag, n.next(), s.count, (int)s.keyBase(), (int)s.refBase(), kb | rb << 8};
+    memset(slot, 0, slotLen);
+    memcpy(slot, head, sizeof(head));
+    char *bits = slot + PACKED_HEADER_BYTES;
+    for (int i = 0; i < s.count; i++) {
+        putBits(bits, (long long)i * kb, kb, (unsigned long long)(n.key(i) - s.keyBase()));
+        putBits(bits, (long long)s.count * kb + (long long)i * rb, rb, (unsigned long long)(n.ref(i) - s.refBase()));
+    }
+}
+
+bool unpackImage(const char *slot, long long slotLen, char *image, int m) {
+    using L = NodeLayout<int, int>;
+    int head[6];
+    memcpy(head, slot, sizeof(head));
+    int flag = head[0], count = head[2], kb = head[5] & 0xFF, rb = head[5] >> 8;
+    if (flag < -1 || flag > 1 || count < 0 || count > m || kb > 32 || rb > 32) return false;
+    if (flag == -1 && count != 0) return false;
+    if (PACKED_HEADER_BYTES + ((long long)count * (kb + rb) + 63) / 64 * 8 > slotLen) return false;
+    emptyImage(image, imageBytes<int, int>(m));
+    headIn(image).set(flag, count);
+    headIn(image).next = head[1];
+    int *keys = reinterpret_cast<int*>(image + L::keysAt());
+    int *refs = reinterpret_cast<int*>(image + L::refsAt(m));
+    const char *bits = slot + PACKED_HEADER_BYTES;
+    long long len = slotLen - PACKED_HEADER_BYTES;
+    long long refPos = (long long)count * kb;
+    for (int i = 0; i < count; i++) {
+        keys[i] = (int)(head[3] + (long long)getBits(bits, len, (long long)i * kb, kb));
+        refs[i] = (int)(head[4] + (long long)getBits(bits, len, refPos + (long long)i * rb, rb));
+    }
+    return true;
+}
+
+// ---------------- HELPERS ----------------
+
+// Raw node I/O: one contiguous read/write of the whole node image at
+// nodeIndex * stride. A node past the end of the file reads back as an
+// empty free node.
+void readNodeImage(fstream &f, int nodeIndex, char *image, long long bytes, long long stride) {
+    f.seekg((long long)nodeIndex * stride, ios::beg);
+    if (f.good() && f.read(image, bytes)) return;
+    f.clear();
+    emptyImage(image, bytes);
+}
+
+void writeNodeImage(fstream &f, int nodeIndex, const char *image, long long bytes, long long stride) {
+    f.seekp((long long)nodeIndex * stride, ios::beg);
+    f.write(image, bytes);
+}
+
+void writeHeaderToDisk(fstream &f, const FileHeader &h) {
+    f.seekp(0, ios::beg);
+    f.write(reinterpret_cast<const char*>(&h), sizeof(h));
+}
+
+// ---------------- STATISTICS ----------------
+
+const char* counterName(Counter c) {
+    static const char* const names[] = {
+        "node reads", "node writes", "seeks", "flushes", "syncs", "allocs", "frees",
+        "leaf splits", "internal splits", "root splits", "run splits", "borrows left",
+        "borrows right", "merges", "max-key steps", "shadow copies", "reclaims", "filter rejects",
+        "tombstones", "purges",
+    };
+    static_assert(size(names) == (size_t)Counter::Count);
+    return names[(int)c];
+}
+
+const char* opName(OpKind k) {
+    static const char* const names[] = {
+        "search", "multiSearch", "insert", "erase", "insertBatch", "eraseBatch", "scan",
+    };
+    static_assert(size(names) == (size_t)OpKind::Count);
+    return names[(int)k];
+}
+
+unsigned long long LatencyHistogram::count() const {
+    unsigned long long n = 0;
+    for (const auto &b : buckets) n += b.load(memory_order_relaxed);
+    return n;
+}
+
+double LatencyHistogram::meanNs() const {
+    unsigned long long n = count();
+    return n ? (double)total.load(memory_order_relaxed) / n : 0.0;
+}
+
+double LatencyHistogram::percentileNs(double p) const {
+    unsigned long long n = count();
+    if (n == 0) return 0.0;
+    unsigned long long rank = max(1ULL, (unsigned long long)(p / 100.0 * n + 0.5));
+    unsigned long long seen = 0;
+    for (int b = 0; b < BUCKETS; b++) {
+        seen += buckets[b].load(memory_order_relaxed);
+        if (seen >= rank) return (double)(2ULL << b);
+    }
+    return (double)(1ULL << BUCKETS);
+}
+
+void LatencyHistogram::add(const LatencyHistogram &other) {
+    for (int b = 0; b < BUCKETS; b++)
+        buckets[b].fetch_add(other.buckets[b].load(memory_order_relaxed), memory_order_relaxed);
+    total.fetch_add(other.total.load(memory_order_relaxed), memory_order_relaxed);
+}
+
+void LatencyHistogram::reset() {
+    for (auto &b : buckets) b.store(0, memory_order_relaxed);
+    total.store(0, memory_order_relaxed);
+}
+
+void IndexStats::add(const IndexStats &other) {
+    for (int c = 0; c < (int)Counter::Count; c++)
+        counters[c].fetch_add(other.counters[c].load(memory_order_relaxed), memory_order_relaxed);
+    for (int k = 0; k < (int)OpKind::Count; k++) ops[k].add(other.ops[k]);
+}
+
+void IndexStats::reset() {
+    for (auto &c : counters) c.store(0, memory_order_relaxed);
+    for (auto &h : ops) h.reset();
+}
+
+void IndexStats::dump(ostream &out) const {
+    ios_base::fmtflags flags = out.flags();
+    streamsize precision = out.precision();
+    out << "counters:\n";
+    for (int c = 0; c < (int)Counter::Count; c++) {
+        unsigned long long v = counters[c].load(memory_order_relaxed);
+        if (v) out << "  " << left << setw(18) << counterName((Counter)c) << right << setw(12) << v << "\n";
+    }
+    out << "latency (us, percentiles are bucket upper bounds):\n";
+    out << "  " << left << setw(12) << "op" << right << setw(10) << "count" << setw(10) << "mean"
+        << setw(10) << "p50" << setw(10) << "p90" << setw(10) << "p99" << setw(10) << "p99.9" << "\n";
+    out << fixed << setprecision(2);
+    for (int k = 0; k < (int)OpKind::Count; k++) {
+        const LatencyHistogram &h = ops[k];
+        if (h.count() == 0) continue;
+        out << "  " << left << setw(12) << opName((OpKind)k) << right << setw(10) << h.count()
+            << setw(10) << h.meanNs() / 1000 << setw(10) << h.percentileNs(50) / 1000
+            << setw(10) << h.percentileNs(90) / 1000 << setw(10) << h.percentileNs(99) / 1000
+            << setw(10) << h.percentileNs(99.9) / 1000 << "\n";
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
+
+IndexStats& sessionStats() {
+    static IndexStats totals;
+    return totals;
+}
+
+// ---------------- STORAGE ----------------
+
+unique_ptr<NodeStore> openStore(const char* filename, StorageMode mode) {
+    if (mode == StorageMode::Mmap) return make_unique<MmapStore>(filename);
+    return make_unique<FileStore>(filename);
+}
+
+void NodeStore::toSlot(int nodeIndex, const char *image, char *slot) const {
+    if (nodeIndex != 0) {
+        packImage(image, m, slot, stride);
+        return;
+    }
+    long long raw = min(stride, imageLen);
+    memcpy(slot, image, raw);
+    memset(slot + raw, 0, stride - raw);
+}
+
+void NodeStore::fromSlot(int nodeIndex, const char *slot, char *image) const {
+    if (nodeIndex != 0) {
+        if (!unpackImage(slot, stride, image, m)) emptyImage(image, imageLen);
+        return;
+    }
+    long long raw = min(stride, imageLen);
+    memset(image, 0, imageLen);
+    memcpy(image, slot, raw);
+}
+
+// ---------------- WRITE-AHEAD LOG ----------------
+
+unsigned fnv1a(const char *data, size_t len) {
+    unsigned h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)data[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// ---------------- BLOOM FILTER ----------------
+
+BloomFilter::BloomFilter(const string &path, int keyBytes) : keyBytes(keyBytes) {
+    fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) return;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < BLOOM_BLOCK) return;
+    void *p = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) return;
+    base = static_cast<char*>(p);
+    mapLen = st.st_size;
+}
+
+// Counts are synced before the file is marked clean, so a clean mark on
+// disk never covers counts that are not.
+BloomFilter::~BloomFilter() {
+    if (base) {
+        if (changed) {
+            msync(base, mapLen, MS_SYNC);
+            header().clean = 1;
+        }
+        munmap(base, mapLen);
+    }
+    if (fd >= 0) close(fd);
+}
+
+bool BloomFilter::stale() const {
+    if (!base) return true;
+    const BloomHeader &h = header();
+    if (h.magic != BLOOM_MAGIC || h.version != BLOOM_VERSION || h.keyBytes != keyBytes || !h.clean) return true;
+    if (h.blocks <= 0 || mapLen != BLOOM_BLOCK * (h.blocks + 1)) return true;
+    return h.keys < 0 || h.keys > h.capacity || (h.capacity > BLOOM_MIN_KEYS && h.keys * 8 < h.capacity);
+}
+
+bool BloomFilter::rebuild(const vector<unsigned long long> &hashes) {
+    if (base) munmap(base, mapLen);
+    base = nullptr;
+    long long capacity = max(BLOOM_MIN_KEYS, 2 * (long long)hashes.size());
+    long long blocks = (capacity * BLOOM_CELLS_PER_KEY + 127) / 128;
+    long long len = BLOOM_BLOCK * (blocks + 1);
+    if (ftruncate(fd, 0) != 0 || ftruncate(fd, len) != 0) return false;   // zero-filled
+    void *p = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) return false;
+    base = static_cast<char*>(p);
+    mapLen = len;
+
+    BloomHeader &h = header();
+    h = {BLOOM_MAGIC, BLOOM_VERSION, 0, keyBytes, blocks, capacity, (long long)hashes.size()};
+    for (unsigned long long x : hashes) count(x, 1);
+    msync(base, mapLen, MS_SYNC);
+    h.clean = 1;
+    return true;
+}
+
+void BloomFilter::change(unsigned long long h, int delta) {
+    call_once(dirtied, [&] {
+        header().clean = 0;
+        msync(base, BLOOM_BLOCK, MS_SYNC);
+        changed = true;
+    });
+    count(h, delta);
+    atomic_ref<long long>(header().keys).fetch_add(delta, memory_order_relaxed);
+}
+
+void BloomFilter::count(unsigned long long h, int delta) {
+    unsigned long long *b = blockOf(h);
+    unsigned long long g = h * 0x9e3779b97f4a7c15ULL;
+    for (int i = 0; i < BLOOM_PROBES; i++, g >>= 7) {
+        int c = g & 127;
+        int shift = (c & 15) * 4;
+        atomic_ref<unsigned long long> word(b[c >> 4]);
+        unsigned long long old = word.load(memory_order_relaxed), next;
+        do {
+            unsigned long long cell = old >> shift & 15;
+            if (cell == 15 || (delta < 0 && cell == 0)) break;
+            next = delta > 0 ? old + (1ULL << shift) : old - (1ULL << shift);
+        } while (!word.compare_exchange_weak(old, next, memory_order_relaxed));
+    }
+}
+
+// ---------------- ASYNC I/O ----------------
+
+unique_ptr<IoEngine> makeIoEngine(IoBackend backend, int queueDepth) {
+#if BTREE_HAVE_URING
+    if (backend != IoBackend::Threads) {
+        auto uring = make_unique<UringEngine>(queueDepth);
+        if (uring->ok()) return uring;
+    }
+#endif
+    return make_unique<ThreadPoolEngine>(IO_THREADS);
+}
+
+// ---------------- REQUIRED FUNCTIONS ----------------
+
+void freeNode(BufferPool &bp, int idx, LatchSet &latches) {
+    // A copy-on-write writer only frees what it allocated itself; readers
+    // may still need the rest.
+    if (ShadowMap *map = bp.shadow(); map && map->writing()) {
+        int slot = map->slotOf(idx);
+        bool fresh = map->isFresh(slot);
+        map->forget(idx, slot);
+        if (!fresh) {
+            map->retire(slot);
+            return;
+        }
+        idx = slot;
+    }
+
+    // 1. Read the Head of the Free List (file header)
+    latches.lock(0);
+    FileHeader &head = headerIn(bp.pinForWrite(0));
+
+    // 2. Overwrite the data at idx with a "clean" free node
+    char *image = bp.pinForWrite(idx);
+    emptyImage(image, bp.imageSize());
+
+    // 3. Link this node into the free list
+    // The new free node points to whatever the header currently points to
+    headIn(image).next = head.freeHead;
+
+    // 4. Update the header to point to this newly freed node
+    head.freeHead = idx;
+
+    // 5. Write changes to disk
+    bp.unpin(idx, true);
+    bp.unpin(0, true);
+    bp.stats().bump(Counter::Frees);
+}
+
+// ---------------- FILE GROWTH ----------------
+
+// Under a write-ahead log the new free nodes are not logged: they are made
+// durable in the file before the header that points to them is committed.
+bool growFile(BufferPool &bp, FileHeader &head) {
+    long long oldCount = head.nodeCount;
+    long long extent = min<long long>(max<long long>(oldCount, MIN_EXTENT_NODES), MAX_EXTENT_NODES);
+    long long newCount = min<long long>(oldCount + extent, INT_MAX);
+    if (newCount <= oldCount) return false;
+    if (!bp.extend(newCount * head.nodeBytes)) return false;
+
+    vector<char> image(bp.imageSize());
+    emptyImage(image.data(), image.size());
+    for (long long i = oldCount; i < newCount; i++) {
+        headIn(image.data()).next = (i + 1 < newCount) ? (int)(i + 1) : head.freeHead;
+        if (!bp.put((int)i, image.data())) return false;
+    }
+    if (bp.logging()) bp.syncStore();
+    head.freeHead = (int)oldCount;
+    head.nodeCount = (int)newCount;
+    return true;
+}
+
+// Take a node off the free list, growing the file if it is empty. With a
+// hint, a free node in the same allocation group as 'near' is preferred
+// (e.g. a split's new sibling next to the node that split).
+int allocateNode(BufferPool &bp, LatchSet &latches, int near) {
+    latches.lock(0);
+    FileHeader &head = headerIn(bp.pinForWrite(0));
+    if (head.freeHead == -1 && !growFile(bp, head)) { bp.unpin(0, false); return -1; }
+
+    auto nextFreeOf = [&](int idx) {
+        int next = headIn(bp.pin(idx)).next;
+        bp.unpin(idx, false);
+        return next;
+    };
+
+    int prevIdx = -1;
+    int freeIdx = head.freeHead;
+    int afterFree = nextFreeOf(freeIdx);
+    if (near != -1 && freeIdx / ALLOC_GROUP_NODES != near / ALLOC_GROUP_NODES) {
+        int p = freeIdx;
+        int pNext = afterFree;
+        for (int step = 0; step < ALLOC_SCAN_LIMIT && pNext != -1; step++) {
+            int c = pNext;
+            int cNext = nextFreeOf(c);
+            if (c / ALLOC_GROUP_NODES == near / ALLOC_GROUP_NODES) {
+                prevIdx = p;
+                freeIdx = c;
+                afterFree = cNext;
+                break;
+            }
+            p = c;
+            pNext = cNext;
+        }
+    }
+
+    if (prevIdx == -1) {
+        head.freeHead = afterFree;
+    } else {
+        headIn(bp.pinForWrite(prevIdx)).next = afterFree;
+        bp.unpin(prevIdx, true);
+    }
+    bp.unpin(0, true);
+
+    // Hand it out as an empty leaf
+    char *image = bp.pinForWrite(freeIdx);
+    emptyImage(image, bp.imageSize());
+    headIn(image).set(0, 0);
+    bp.unpin(freeIdx, true);
+    if (ShadowMap *map = bp.shadow(); map && map->writing()) map->markFresh(freeIdx);
+    bp.stats().bump(Counter::Allocs);
+    return freeIdx;
+}
+
+// ---------------- SHADOW PAGING ----------------
+
+int shadowWritable(BufferPool &bp, int nodeIndex) {
+    ShadowMap *map = bp.shadow();
+    if (!map || !map->writing()) return nodeIndex;
+    int slot = map->slotOf(nodeIndex);
+    if (map->isFresh(slot)) return slot;
+    LatchSet none(nullptr, true);
+    int copy = allocateNode(bp, none, slot);
+    if (copy == -1) return slot;   // the file cannot grow: change it in place after all
+    map->moveTo(nodeIndex, copy);
+    bp.stats().bump(Counter::ShadowCopies);
+    return copy;
+}
+
+void reclaimRetired(BufferPool &bp) {
+    LatchSet none(nullptr, true);
+    for (int slot : bp.shadow()->takeReclaimable()) {
+        freeNode(bp, slot, none);
+        bp.stats().bump(Counter::Reclaims);
+    }
+}
+
+// Split 'count' items into node-sized groups of about 'perNode' each,
+// never leaving a group below minKeys (unless there is only one group).
+vector<int> groupSizes(int count, int perNode, int minKeys) {
+    int groups = (count + perNode - 1) / perNode;
+    while (groups > 1 && count / groups < minKeys) groups--;
+    vector<int> sizes(groups, count / groups);
+    for (int i = 0; i < count % groups; i++) sizes[i]++;
+    return sizes;
+}
+
+// The rest of a run goes next to one entry: in a leaf, just before the key
+// above the new one (ascending) or the new key itself (descending), since
+// a parent routes a key to the first child whose max is not below it; in
+// a parent, just after the new child entry (ascending) or the one before
+// it, the child that split (descending). Whichever side that entry goes
+// to should be the emptier one. A leaf run past its last key leaves the
+// new key alone on the right. Both parents keep two children, so every
+// child still has a sibling to borrow from or merge with.
+int splitPoint(int n, int at, int run, bool leaf) {
+    if (run == 0) return n / 2;
+    int next = leaf ? (run > 0 ? at + 1 : at) : (run > 0 ? at : at - 1);
+    int mid = next >= n ? n - 1 : next + 1 <= n - next ? next + 1 : next;
+    int least = leaf ? 1 : 2;
+    return clamp(mid, least, n - least);
+}
+
+vector<vector<int>> placeNodes(const vector<vector<int>> &sizes, NodeOrder order) {
+    int levels = (int)sizes.size();
+    vector<vector<int>> slot(levels);
+    for (int l = 0; l < levels; l++) slot[l].resize(sizes[l].size());
+    int next = 1;
+    if (order == NodeOrder::LeavesFirst) {
+        next = 2;
+        for (int l = 0; l + 1 < levels; l++)
+            for (int &s : slot[l]) s = next++;
+        slot[levels - 1][0] = 1;
+        return slot;
+    }
+    if (order == NodeOrder::BreadthFirst) {
+        for (int l = levels - 1; l >= 0; l--)
+            for (int &s : slot[l]) s = next++;
+        return slot;
+    }
+
+    // first[l][g]: where the children of node g of level l start on level l - 1
+    vector<vector<int>> first(levels);
+    for (int l = 1; l < levels; l++) {
+        first[l].assign(sizes[l].size() + 1, 0);
+        for (size_t g = 0; g < sizes[l].size(); g++) first[l][g + 1] = first[l][g] + sizes[l][g];
+    }
+    // Subtree of node g on level l, height levels deep: its top height / 2
+    // levels, then each subtree hanging below them.
+    function<void(int, int, int)> place = [&](int l, int g, int height) {
+        if (height == 1) {
+            slot[l][g] = next++;
+            return;
+        }
+        int top = height / 2;
+        place(l, g, top);
+        int lo = g, hi = g + 1;
+        for (int d = l; d > l - top; d--) {
+            lo = first[d][lo];
+            hi = first[d][hi];
+        }
+        for (int c = lo; c < hi; c++) place(l - top, c, height - top);
+    };
+    place(levels - 1, 0, levels);
+    return slot;
+}
+
+void DisplayIndexFileContent(char* filename) {
+    BTreeIndex idx(filename);
+    if (!idx.isOpen()) return;
+    idx.display(cout);
+}
+
+int SearchARecord(char* filename, int RecordID) {
+    BTreeIndex idx(filename);
+    if (!idx.isOpen()) return -1;
+    return idx.search(RecordID);
+}
+
+void MultiSearch(char* filename, span<const int> ids, span<int> refsOut) {
+    BTreeIndex idx(filename);
+    if (!idx.isOpen()) {
+        fill(refsOut.begin(), refsOut.end(), -1);
+        return;
+    }
+    idx.multiSearch(ids, refsOut);
+}
+
+void DeleteRecordFromIndex(char* filename, int RecordID) {
+    BTreeIndex idx(filename);
+    if (!idx.isOpen()) return;
+    if (idx.erase(RecordID)) cout << "Record " << RecordID << " deleted successfully.\n";
+    else cout << "Record " << RecordID << " not found.\n";
+}
+
+int InsertNewRecordAtIndex(char* filename, int RecID, int Ref) {
+    BTreeIndex idx(filename);
+    if (!idx.isOpen()) return -1;
+    return idx.insert(RecID, Ref);
+}
+
+int InsertBatch(char* filename, vector<pair<int, int>> records) {
+    BTreeIndex idx(filename);
+    if (!idx.isOpen()) return 0;
+    return idx.insertBatch(std::move(records));
+}
+
+int DeleteBatch(char* filename, vector<int> ids) {
+    BTreeIndex idx(filename);
+    if (!idx.isOpen()) return 0;
+    return idx.eraseBatch(std::move(ids));
+}
+
+void DisplayIndexStats() {
+    sessionStats().dump(cout);
+}
+
@@ -0,0 +1,2385 @@
+// btree.h
+// Disk-resident B-tree index: file format, storage, buffer pool, WAL,
+// Bloom filter, latches and the index handles. Definitions live in
+// btree.cpp, templates in btree_impl.h.
+
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <map>
+#include <climits>
+#include <memory>
+#include <array>
+#include <cstring>
+#include <type_traits>
+#include <chrono>
+#include <random>
+#include <filesystem>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <shared_mutex>
+#include <atomic>
+#include <thread>
+#include <optional>
+#include <span>
+#include <numeric>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <functional>
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#define BTREE_HAVE_URING 1
+#else
+#define BTREE_HAVE_URING 0
+#endif
+
+using namespace std;
+
+// ---------------- CONFIGURATION ----------------
+static constexpr int INT_BYTES = sizeof(int);
+
+// Every node image starts with the same 8-byte head whatever its key and
+// ref types: info = count << 2 | (flag + 1), then next. Entries [0, count)
+// are in use, so no key value is reserved as "empty"; a zeroed head is an
+// empty free node.
+struct NodeHead {
+    unsigned info;
+    int next;       // leaves: right sibling in key order; free nodes: next free node; -1 if none
+
+    int flag() const { return (int)(info & 3) - 1; }
+    int count() const { return (int)(info >> 2); }
+    void set(int flag, int count) { info = (unsigned)count << 2 | (unsigned)(flag + 1); }
+};
+
+inline NodeHead& headIn(char *image) { return *reinterpret_cast<NodeHead*>(image); }
+inline const NodeHead& headIn(const char *image) { return *reinterpret_cast<const NodeHead*>(image); }
+
+// Node image for order m with keys K and refs V:
+//   [head][key0 .. key(m-1)][ref0 .. ref(m-1)]
+// Keys and refs are kept in separate arrays, each aligned for its type, so
+// no combination of types pads between entries: int/int is 8 + 8m bytes,
+// long long/long long 8 + 16m.
+template<class K, class V>
+struct NodeLayout {
+    static constexpr long long alignUp(long long n, long long a) { return (n + a - 1) / a * a; }
+    static constexpr long long ALIGN = max({alignof(NodeHead), alignof(K), alignof(V)});
+
+    static constexpr long long keysAt() { return alignUp(sizeof(NodeHead), alignof(K)); }
+    static constexpr long long refsAt(int m) { return alignUp(keysAt() + (long long)m * sizeof(K), alignof(V)); }
+    static constexpr long long bytes(int m) { return alignUp(refsAt(m) + (long long)m * sizeof(V), ALIGN); }
+
+    // Largest order whose node fits in one page of pageBytes
+    static constexpr int orderForPage(int pageBytes) {
+        int m = (int)((pageBytes - keysAt()) / (long long)(sizeof(K) + sizeof(V)));
+        while (m > 0 && bytes(m) > pageBytes) m--;
+        return m;
+    }
+};
+
+constexpr long long nodeSize(int m) {
+    // Head(8) + m * (Key(4) + Ref(4))
+    return NodeLayout<int, int>::bytes(m);
+}
+
+// Largest order whose int node fits in one page of pageBytes
+constexpr int orderForPage(int pageBytes) {
+    return NodeLayout<int, int>::orderForPage(pageBytes);
+}
+
+// Fanouts where one int node exactly fills a 4 KiB / 16 KiB page
+static constexpr int FANOUT_4K = orderForPage(4096);
+static constexpr int FANOUT_16K = orderForPage(16384);
+
+// How nodes other than the header are laid out in their slots. Plain
+// slots hold the node image itself. Packed slots hold
+//   [flag][next][count][keyBase][refBase][keyBits | refBits << 8] bits...
+// with every key and ref stored as a bit-packed offset from its base
+// (frame of reference). Leaf keys and all refs are packed; internal keys
+// keep 32 bits since max-key propagation rewrites them in place. Images
+// are unpacked on the way into the buffer pool, so everything above the
+// store works on plain images. Only int keys and refs are packed: files
+// of other types are always plain.
+enum class NodeFormat { Plain, Packed };
+
+template<class K, class V>
+constexpr bool PACKABLE = is_same_v<K, int> && is_same_v<V, int>;
+
+static constexpr long long PACKED_HEADER_BYTES = 24;
+
+// Packed slot size for order m: room for half a node plus one entry even
+// when nothing compresses, so both halves of a split always fit. With
+// pageBytes > 0 it is rounded up to whole pages.
+constexpr long long packedSlotBytes(int m, int pageBytes) {
+    long long need = PACKED_HEADER_BYTES + 8LL * ((m + 2) / 2);
+    if (pageBytes <= 0) return need;
+    return (need + pageBytes - 1) / pageBytes * pageBytes;
+}
+
+// ---------------- FILE HEADER ----------------
+// Slot 0 holds the header instead of a node. The order, slot size, key and
+// ref widths and root are read from here when the file is opened, so
+// fanout is a per-file choice.
+static constexpr int HEADER_MAGIC = 0x58495442; // "BTIX"
+static constexpr int HEADER_VERSION = 3;   // 3: counted nodes with typed keys/refs; older files need a rebuild
+static constexpr int MIN_ORDER = 4;
+
+struct FileHeader {
+    int magic;
+    int version;
+    int m;           // key/ref pairs per node
+    int nodeBytes;   // slot size on disk, >= imageBytes(m)
+    int root;        // root node index
+    int nodeCount;   // slots in the file, header slot included
+    int freeHead;    // first free node, -1 if none
+    int format;      // NodeFormat of every slot after the header
+    int keyBytes;    // sizeof the key type the file was created with
+    int refBytes;    // sizeof the ref type
+};
+
+static_assert(sizeof(FileHeader) <= nodeSize(MIN_ORDER));
+FileHeader& headerIn(char *image);
+
+// Bytes of one node image in memory (pool frames, log records, plain
+// slots). The header lives in a frame of the same size.
+template<class K, class V>
+constexpr long long imageBytes(int m) {
+    return max<long long>(NodeLayout<K, V>::bytes(m), sizeof(FileHeader));
+}
+
+// On-disk slot size for order m. With pageBytes > 0 every node is padded
+// to a whole number of pages, so node i starts on a page boundary.
+template<class K = int, class V = int>
+constexpr long long slotBytes(int m, int pageBytes) {
+    long long bytes = imageBytes<K, V>(m);
+    if (pageBytes <= 0) return bytes;
+    return (bytes + pageBytes - 1) / pageBytes * pageBytes;
+}
+
+// A node copied out of its image. key and ref have room for m entries; the
+// first count are in use, in ascending key order.
+template<class K, class V>
+struct BasicNode {
+    int flag;          // 0 = leaf, 1 = internal, -1 = free
+    int count;
+    vector<K> key;
+    vector<V> ref;     // record refs in leaves, child node indices in internal nodes
+    int next;          // leaves: right sibling in key order; free nodes: next free node; -1 if none
+
+    BasicNode(int m) : flag(-1), count(0), key(m), ref(m), next(-1) {}
+};
+
+using Node = BasicNode<int, int>;
+
+// Compile-time fanout node. Its layout is exactly the NodeLayout<K, V>
+// image of order M, so it can be used in place over a pool frame or a
+// mapping, with no heap allocation and offsets the compiler knows.
+template<class K, class V, int M>
+struct FixedNode {
+    NodeHead head;
+    array<K, M> key;
+    array<V, M> ref;
+
+    int flag() const { return head.flag(); }
+    // Clamped: an optimistic reader may catch the head mid-update.
+    int count() const { return min(head.count(), M); }
+
+    static const FixedNode& at(const char *image) {
+        return *reinterpret_cast<const FixedNode*>(image);
+    }
+};
+
+static_assert(is_trivially_copyable_v<FixedNode<int, int, 5>>);
+static_assert(sizeof(FixedNode<int, int, 5>) == nodeSize(5));
+static_assert(sizeof(FixedNode<int, int, FANOUT_4K>) == 4096);
+static_assert(sizeof(FixedNode<int, int, FANOUT_16K>) == 16384);
+static_assert(sizeof(FixedNode<long long, long long, 5>) == NodeLayout<long long, long long>::bytes(5));
+
+// An empty free node, which is also what a slot past the end of the file reads as.
+inline void emptyImage(char *image, long long bytes) {
+    memset(image, 0, bytes);
+    headIn(image).next = -1;
+}
+
+template<class K, class V> BasicNode<K, V> decodeNode(const char *image, int m);
+template<class K, class V> void encodeNode(const BasicNode<K, V> &n, char *image, int m);
+
+// Bytes n takes in a packed slot; the second form with (key, ref) added.
+long long packedBytes(const Node &n);
+long long packedBytes(const Node &n, int key, int ref);
+// Plain int image <-> packed slot. packImage fills the whole slot and
+// needs the node to fit; unpackImage returns false if the slot does not
+// hold a valid packed node.
+void packImage(const char *image, int m, char *slot, long long slotLen);
+bool unpackImage(const char *slot, long long slotLen, char *image, int m);
+
+// ---------------- NODE SEARCH KERNEL ----------------
+// Slot of the first of keys[0, count) that is not ordered before probe, or
+// count if there is none. Signed 32-bit keys under the default ordering
+// are compared 8 (AVX2) or 4 (SSE2) at a time, signed 64-bit ones 4 at a
+// time with AVX2; anything else goes through cmp one key at a time.
+template<class K, class Compare = less<K>>
+int firstKeyAtLeastScalar(const K *keys, int count, const K &probe, Compare cmp = {}) {
+    for (int i = 0; i < count; i++) {
+        if (!cmp(keys[i], probe)) return i;
+    }
+    return count;
+}
+
+// Slot of the first key ordered after probe, or count.
+template<class K, class Compare = less<K>>
+int firstKeyAbove(const K *keys, int count, const K &probe, Compare cmp = {}) {
+    for (int i = 0; i < count; i++) {
+        if (cmp(probe, keys[i])) return i;
+    }
+    return count;
+}
+
+template<class K, class Compare = less<K>>
+int firstKeyAtLeast(const K *keys, int count, const K &probe, Compare cmp = {}) {
+    constexpr bool plainOrder = is_same_v<Compare, less<K>> && is_integral_v<K> && is_signed_v<K>;
+    int i = 0;
+    if constexpr (plainOrder && sizeof(K) == 4) {
+#if defined(__AVX2__)
+        const __m256i p8 = _mm256_set1_epi32(probe);
+        for (; i + 8 <= count; i += 8) {
+            __m256i k = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+            // key >= probe  <=>  !(probe > key)
+            int mask = ~_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(p8, k))) & 0xFF;
+            if (mask) return i + __builtin_ctz(mask);
+        }
+#endif
+#if defined(__SSE2__)
+        const __m128i p4 = _mm_set1_epi32(probe);
+        for (; i + 4 <= count; i += 4) {
+            __m128i k = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i));
+            int mask = ~_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(p4, k))) & 0xF;
+            if (mask) return i + __builtin_ctz(mask);
+        }
+#endif
+    } else if constexpr (plainOrder && sizeof(K) == 8) {
+#if defined(__AVX2__)
+        const __m256i p4 = _mm256_set1_epi64x(probe);
+        for (; i + 4 <= count; i += 4) {
+            __m256i k = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+            int mask = ~_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(p4, k))) & 0xF;
+            if (mask) return i + __builtin_ctz(mask);
+        }
+#endif
+    }
+    return i + firstKeyAtLeastScalar(keys + i, count - i, probe, cmp);
+}
+
+// ---------------- HELPERS ----------------
+
+template<class K, class Compare>
+bool keyEq(const K &a, const K &b, Compare cmp) {
+    return !cmp(a, b) && !cmp(b, a);
+}
+
+template<class K, class V>
+int countKeys(const BasicNode<K, V> &n) {
+    return n.count;
+}
+
+// Largest key of a non-empty node
+template<class K, class V>
+K getMaxKey(const BasicNode<K, V> &n) {
+    return n.key[n.count - 1];
+}
+
+void readNodeImage(fstream &f, int nodeIndex, char *image, long long bytes, long long stride);
+
+void writeNodeImage(fstream &f, int nodeIndex, const char *image, long long bytes, long long stride);
+template<class K, class V>
+void writeNodeToDisk(fstream &f, int nodeIndex, const BasicNode<K, V> &n, int m, long long stride,
+                     NodeFormat format = NodeFormat::Plain);
+
+void writeHeaderToDisk(fstream &f, const FileHeader &h);
+
+// ---------------- STATISTICS ----------------
+// Always-on counters for one open index file, kept by its store. They are
+// relaxed atomics, so bumping one costs a single uncontended add.
+enum class Counter {
+    NodeReads,        // node images loaded from the store
+    NodeWrites,       // node images written to the store
+    Seeks,            // positioned I/O not continuing the previous one
+    Flushes,          // buffered writes handed to the OS
+    Syncs,            // fsync/msync of the store
+    Allocs,
+    Frees,
+    LeafSplits,
+    InternalSplits,
+    RootSplits,
+    RunSplits,        // splits placed for a sequential run instead of in the middle
+    BorrowsLeft,
+    BorrowsRight,
+    Merges,
+    MaxKeySteps,      // parent keys rewritten to follow a child's max
+    ShadowCopies,     // nodes copied rather than changed in place (copy-on-write)
+    Reclaims,         // replaced nodes back on the free list after their last snapshot
+    FilterRejects,    // lookups the Bloom filter answered without reading a node
+    Tombstones,       // entries marked deleted by a deferred erase
+    Purges,           // tombstones removed from their leaves by maintenance
+    Count
+};
+
+enum class OpKind { Search, MultiSearch, Insert, Erase, InsertBatch, EraseBatch, Scan, Count };
+
+const char* counterName(Counter c);
+const char* opName(OpKind k);
+
+// Latencies in power-of-two buckets: bucket b holds [2^b, 2^(b+1)) ns.
+class LatencyHistogram {
+public:
+    static constexpr int BUCKETS = 40;
+
+    void record(unsigned long long ns) {
+        int b = min(BUCKETS - 1, 63 - __builtin_clzll(ns | 1));
+        buckets[b].fetch_add(1, memory_order_relaxed);
+        total.fetch_add(ns, memory_order_relaxed);
+    }
+    unsigned long long count() const;
+    double meanNs() const;
+    // Upper edge of the bucket holding the p-th percentile (p in [0, 100]).
+    double percentileNs(double p) const;
+    void add(const LatencyHistogram &other);
+    void reset();
+
+private:
+    array<atomic<unsigned long long>, BUCKETS> buckets{};
+    atomic<unsigned long long> total{0};
+};
+
+class IndexStats {
+public:
+    void bump(Counter c, unsigned long long n = 1) {
+        counters[(int)c].fetch_add(n, memory_order_relaxed);
+    }
+    unsigned long long get(Counter c) const { return counters[(int)c].load(memory_order_relaxed); }
+    LatencyHistogram& latency(OpKind k) { return ops[(int)k]; }
+    const LatencyHistogram& latency(OpKind k) const { return ops[(int)k]; }
+
+    void add(const IndexStats &other);
+    void reset();
+    // Every non-zero counter, then count/mean/percentiles per operation.
+    void dump(ostream &out) const;
+
+private:
+    array<atomic<unsigned long long>, (int)Counter::Count> counters{};
+    array<LatencyHistogram, (int)OpKind::Count> ops;
+};
+
+// Totals of every BTreeIndex closed so far in this process.
+IndexStats& sessionStats();
+
+// Records the lifetime of the enclosing scope as one operation.
+class OpTimer {
+public:
+    OpTimer(IndexStats &stats, OpKind kind) : hist(stats.latency(kind)), start(chrono::steady_clock::now()) {}
+    ~OpTimer() {
+        auto ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+        hist.record(ns);
+    }
+
+private:
+    LatencyHistogram &hist;
+    chrono::steady_clock::time_point start;
+};
+
+// ---------------- STORAGE ----------------
+// Where node images live. FileStore goes through fstream; MmapStore maps the
+// whole index file and can hand out zero-copy views of a node.
+enum class StorageMode { File, Mmap };
+
+// Typed read-only view of one node image in place (a mapping or a pool
+// frame), laid out as NodeLayout<K, V> for order m.
+template<class K, class V>
+struct NodeView {
+    const char *p;
+    int m;
+
+    int flag() const { return headIn(p).flag(); }
+    // Clamped: an optimistic reader may catch the head mid-update.
+    int count() const { return min(headIn(p).count(), m); }
+    int next() const { return headIn(p).next; }
+    const K* keys() const { return reinterpret_cast<const K*>(p + NodeLayout<K, V>::keysAt()); }
+    const V* refs() const { return reinterpret_cast<const V*>(p + NodeLayout<K, V>::refsAt(m)); }
+    const K& key(int i) const { return keys()[i]; }
+    const V& ref(int i) const { return refs()[i]; }
+};
+
+// Stores move raw node images of imageSize() bytes; the layout inside them
+// is the index's business. Packed transcoding, the one exception, only
+// exists for int images.
+class NodeStore {
+public:
+    virtual ~NodeStore() = default;
+    virtual bool isOpen() const = 0;
+    virtual bool readHeader(FileHeader &h) = 0;
+    virtual void readImage(int nodeIndex, char *image) = 0;
+    // Whether the image reached the store; the caller keeps it otherwise.
+    virtual bool writeImage(int nodeIndex, const char *image) = 0;
+    virtual long long size() = 0;     // bytes currently in the file
+    virtual void flush() = 0;         // hand buffered writes to the OS
+    virtual void sync() = 0;          // make everything written so far durable
+    // Grow the file to newSize bytes with the space actually reserved
+    // (fallocate), so later node writes do not fragment the file.
+    virtual bool extend(long long newSize) = 0;
+    // Pointer to the node image if the store is mapped, nullptr otherwise.
+    virtual const char* view(int) { return nullptr; }
+    // Descriptor for asynchronous node I/O (-1 if the store has none);
+    // flush() first so it sees every buffered write.
+    virtual int descriptor() const { return -1; }
+    // Zero-copy views need plain slots.
+    bool mapped() const { return isMapped && format == NodeFormat::Plain; }
+    void setStride(long long bytes) { stride = bytes; }
+    long long slotStride() const { return stride; }
+    void setFormat(NodeFormat f) { format = f; }
+    NodeFormat nodeFormat() const { return format; }
+    // Image size and order of the file's nodes, from its header.
+    void setImage(long long bytes, int order) {
+        imageLen = bytes;
+        m = order;
+    }
+    long long imageSize() const { return imageLen; }
+    IndexStats& stats() { return counters; }
+
+    // Whether n (with (key, ref) added) fits a slot: always for plain slots.
+    template<class K, class V>
+    bool fits(const BasicNode<K, V> &n) const {
+        if constexpr (PACKABLE<K, V>) return format == NodeFormat::Plain || packedBytes(n) <= stride;
+        else return true;
+    }
+    template<class K, class V>
+    bool fitsWith(const BasicNode<K, V> &n, const K &key, const V &ref) const {
+        if constexpr (PACKABLE<K, V>) return format == NodeFormat::Plain || packedBytes(n, key, ref) <= stride;
+        else return true;
+    }
+    // Entries any node can hold whatever their values.
+    int sureEntries() const {
+        if (format == NodeFormat::Plain) return m;
+        return (int)min<long long>(m, (stride - PACKED_HEADER_BYTES) / 8);
+    }
+
+protected:
+    bool isMapped = false;
+    long long stride = 0;     // slot size, from the file header
+    long long imageLen = 0;   // node image size
+    int m = 0;
+    NodeFormat format = NodeFormat::Plain;
+    IndexStats counters;
+
+    // Packed slot transcoding; slot 0 (the header) is kept raw.
+    void toSlot(int nodeIndex, const char *image, char *slot) const;
+    void fromSlot(int nodeIndex, const char *slot, char *image) const;
+};
+
+class FileStore : public NodeStore {
+public:
+    explicit FileStore(const char* filename) : f(filename, ios::in | ios::out | ios::binary) {
+        // Second descriptor for the calls fstream does not offer (fallocate, fsync)
+        if (f.is_open()) fd = open(filename, O_RDWR);
+    }
+
+    ~FileStore() override {
+        if (fd >= 0) close(fd);
+    }
+
+    bool isOpen() const override { return f.is_open(); }
+    bool readHeader(FileHeader &h) override {
+        f.seekg(0, ios::beg);
+        pos = -1;
+        if (f.read(reinterpret_cast<char*>(&h), sizeof(h))) return true;
+        f.clear();
+        return false;
+    }
+    void readImage(int nodeIndex, char *out) override {
+        moveTo(nodeIndex);
+        if (format == NodeFormat::Plain) {
+            readNodeImage(f, nodeIndex, out, imageLen, stride);
+            return;
+        }
+        slot.resize(stride);
+        f.seekg((long long)nodeIndex * stride, ios::beg);
+        if (f.good() && f.read(slot.data(), stride)) {
+            fromSlot(nodeIndex, slot.data(), out);
+            return;
+        }
+        f.clear();
+        emptyImage(out, imageLen);
+    }
+    bool writeImage(int nodeIndex, const char *in) override {
+        moveTo(nodeIndex);
+        if (format == NodeFormat::Plain) {
+            writeNodeImage(f, nodeIndex, in, imageLen, stride);
+        } else {
+            slot.resize(stride);
+            toSlot(nodeIndex, in, slot.data());
+            f.seekp((long long)nodeIndex * stride, ios::beg);
+            f.write(slot.data(), stride);
+        }
+        if (f.good()) return true;
+        f.clear();
+        pos = -1;
+        return false;
+    }
+    long long size() override {
+        f.seekg(0, ios::end);
+        pos = -1;
+        return f.tellg();
+    }
+    void flush() override {
+        f.flush();
+        counters.bump(Counter::Flushes);
+    }
+    void sync() override {
+        f.flush();
+        if (fd >= 0) fsync(fd);
+        counters.bump(Counter::Syncs);
+    }
+    bool extend(long long newSize) override {
+        f.flush();
+        return fd >= 0 && posix_fallocate(fd, 0, newSize) == 0;
+    }
+    // Raw reads of packed slots are not node images.
+    int descriptor() const override { return format == NodeFormat::Plain ? fd : -1; }
+
+private:
+    fstream f;
+    int fd = -1;
+    long long pos = -1;       // where the last node I/O ended
+    vector<char> slot;        // packed slot being transcoded
+
+    // Count a seek unless this node directly follows the last one touched.
+    void moveTo(int nodeIndex) {
+        long long off = (long long)nodeIndex * stride;
+        if (off != pos) counters.bump(Counter::Seeks);
+        pos = off + stride;
+    }
+};
+
+class MmapStore : public NodeStore {
+public:
+    explicit MmapStore(const char* filename) {
+        isMapped = true;
+        fd = open(filename, O_RDWR);
+        if (fd < 0) return;
+        struct stat st;
+        if (fstat(fd, &st) != 0) { close(fd); fd = -1; return; }
+        fileSize = st.st_size;
+        if (fileSize > 0) remap(fileSize);
+    }
+
+    ~MmapStore() override {
+        if (base) munmap(base, mapSize);
+        for (auto &[p, len] : retired) munmap(p, len);
+        if (fd >= 0) close(fd);
+    }
+
+    bool isOpen() const override { return fd >= 0; }
+
+    bool readHeader(FileHeader &h) override {
+        if (fileSize < (long long)sizeof(h)) return false;
+        memcpy(&h, base.load(), sizeof(h));
+        return true;
+    }
+
+    const char* view(int nodeIndex) override {
+        if (format != NodeFormat::Plain) return nullptr;
+        return slotAt(nodeIndex, imageLen);
+    }
+
+    void readImage(int nodeIndex, char *out) override {
+        bool plain = format == NodeFormat::Plain;
+        const char *p = slotAt(nodeIndex, plain ? imageLen : stride);
+        if (!p) emptyImage(out, imageLen);
+        else if (plain) memcpy(out, p, imageLen);
+        else fromSlot(nodeIndex, p, out);
+    }
+
+    // Fails if the file cannot grow to hold the slot.
+    bool writeImage(int nodeIndex, const char *in) override {
+        long long off = (long long)nodeIndex * stride;
+        long long len = format == NodeFormat::Plain ? imageLen : stride;
+        if (nodeIndex < 0) return false;
+        if (off + len > fileSize && !grow(off + stride)) return false;
+        if (format == NodeFormat::Plain) memcpy(base.load() + off, in, len);
+        else toSlot(nodeIndex, in, base.load() + off);
+        return true;
+    }
+
+    long long size() override { return fileSize; }
+    void flush() override {}
+    void sync() override {
+        if (base) msync(base, fileSize, MS_SYNC);
+        counters.bump(Counter::Syncs);
+    }
+    bool extend(long long newSize) override { return newSize <= fileSize || grow(newSize); }
+
+private:
+    int fd = -1;
+    // Read without locks by concurrent lookups, hence atomic
+    atomic<char*> base{nullptr};
+    atomic<long long> fileSize{0};
+    long long mapSize = 0;
+    // Outgrown mappings. They stay mapped until the store closes so a
+    // pointer taken before a remap keeps reading the same (shared) pages.
+    vector<pair<char*, long long>> retired;
+
+    // Start of the len bytes of slot nodeIndex, nullptr past the end of the file.
+    const char* slotAt(int nodeIndex, long long len) const {
+        long long off = (long long)nodeIndex * stride;
+        if (nodeIndex < 0 || off + len > fileSize.load(memory_order_acquire)) return nullptr;
+        return base.load(memory_order_acquire) + off;
+    }
+
+    // Extend the file to newSize. The mapping itself grows geometrically so
+    // that appending nodes one at a time does not remap every time.
+    bool grow(long long newSize) {
+        if (posix_fallocate(fd, 0, newSize) != 0 && ftruncate(fd, newSize) != 0) return false;
+        if (newSize > mapSize && !remap(max(newSize, 2 * mapSize))) return false;
+        fileSize.store(newSize, memory_order_release);
+        return true;
+    }
+
+    bool remap(long long len) {
+        char *old = base.load();
+        if (old && mremap(old, mapSize, len, 0) != MAP_FAILED) {
+            mapSize = len;
+            return true;
+        }
+        void *p = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED) return false;
+        if (old) retired.push_back({old, mapSize});
+        base.store(static_cast<char*>(p), memory_order_release);
+        mapSize = len;
+        return true;
+    }
+};
+
+unique_ptr<NodeStore> openStore(const char* filename, StorageMode mode);
+// Check the header against the index's key and ref types, set the store
+// up for the file's layout and return its order; 0 if the file has no
+// valid header for them.
+template<class K, class V> int getM(NodeStore &store);
+
+// ---------------- WRITE-AHEAD LOG ----------------
+// Redo log next to the index file (<index>.wal). Each logical operation is
+// one record holding the after-image of every node it changed:
+//   [magic][payload bytes][lsn] { [nodeIndex][node image] }... [checksum]
+// Committing appends the record and waits until it is on disk; callers that
+// commit while an fsync is in flight are written and synced together by the
+// next leader (group commit). Recovery replays every complete record.
+static constexpr unsigned WAL_MAGIC = 0x524C4157; // "WALR"
+static constexpr long long WAL_CHECKPOINT_BYTES = 16LL << 20;
+
+unsigned fnv1a(const char *data, size_t len);
+
+class WriteAheadLog {
+public:
+    explicit WriteAheadLog(const string &path) {
+        fd = open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    }
+
+    ~WriteAheadLog() {
+        if (fd >= 0) close(fd);
+    }
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    bool isOpen() const { return fd >= 0; }
+    long long size() const { return bytes; }
+    // A write or sync failed: the log takes nothing more.
+    bool failed() const { return broken; }
+
+    // Apply every complete record to the store, make the store durable and
+    // empty the log. A torn or corrupt tail (crash mid-append) is ignored.
+    // If the store refuses an image the log is kept whole for the next open
+    // and fails every commit meanwhile.
+    void recover(NodeStore &store, long long imageBytes) {
+        string data;
+        char buf[1 << 16];
+        ssize_t n;
+        lseek(fd, 0, SEEK_SET);
+        while ((n = read(fd, buf, sizeof(buf))) > 0) data.append(buf, n);
+
+        size_t entryBytes = sizeof(int) + imageBytes;
+        size_t pos = 0;
+        bool applied = false;
+        while (pos + 16 <= data.size()) {
+            unsigned magic, payload;
+            unsigned long long lsn;
+            memcpy(&magic, data.data() + pos, 4);
+            memcpy(&payload, data.data() + pos + 4, 4);
+            memcpy(&lsn, data.data() + pos + 8, 8);
+            if (magic != WAL_MAGIC || payload % entryBytes != 0) break;
+            if (pos + 16 + payload + 4 > data.size()) break;
+            const char *body = data.data() + pos + 16;
+            unsigned sum;
+            memcpy(&sum, body + payload, 4);
+            if (sum != fnv1a(body, payload)) break;
+
+            for (size_t off = 0; off < payload; off += entryBytes) {
+                int nodeIndex;
+                memcpy(&nodeIndex, body + off, sizeof(int));
+                if (!store.writeImage(nodeIndex, body + off + sizeof(int))) broken = true;
+            }
+            applied = true;
+            nextLsn = durableLsn = lsn + 1;
+            pos += 16 + payload + 4;
+        }
+        if (applied) {
+            store.flush();
+            store.sync();
+        }
+        if (!broken) truncate();
+    }
+
+    // Log one operation's node images and return once they are durable.
+    // Returns false if they could not be made durable. The batch that
+    // failed is cut off again, so recover() still reads every record
+    // before it, and the log fails every commit from then on.
+    bool commit(const vector<pair<int, const char*>> &images, long long imageBytes) {
+        unique_lock<mutex> lk(mu);
+        if (broken) return false;
+        unsigned long long lsn = nextLsn++;
+        appendRecord(lsn, images, imageBytes);
+        while (durableLsn < lsn) {
+            if (broken) return false;
+            if (flushing) { cv.wait(lk); continue; }
+            // Become the leader: write everything queued so far with one fsync.
+            flushing = true;
+            string batch;
+            batch.swap(pending);
+            unsigned long long upTo = nextLsn - 1;
+            lk.unlock();
+            bool ok = writeAll(batch) && fdatasync(fd) == 0;
+            if (!ok && ftruncate(fd, bytes) == 0) fdatasync(fd);
+            lk.lock();
+            flushing = false;
+            if (ok) {
+                durableLsn = upTo;
+                bytes += batch.size();
+            } else {
+                broken = true;
+            }
+            cv.notify_all();
+        }
+        return true;
+    }
+
+    // Drop the whole log; only valid once every logged image is durable in
+    // the index file (checkpoint).
+    void truncate() {
+        lock_guard<mutex> lk(mu);
+        if (ftruncate(fd, 0) == 0) fsync(fd);
+        bytes = 0;
+    }
+
+private:
+    int fd = -1;
+    mutex mu;
+    condition_variable cv;
+    string pending;                  // records not yet written
+    bool flushing = false;
+    atomic<bool> broken{false};
+    unsigned long long nextLsn = 1;
+    unsigned long long durableLsn = 0;
+    atomic<long long> bytes{0};      // bytes in the log file
+
+    void appendRecord(unsigned long long lsn, const vector<pair<int, const char*>> &images, long long imageBytes) {
+        size_t start = pending.size();
+        unsigned payload = images.size() * (sizeof(int) + imageBytes);
+        pending.append(reinterpret_cast<const char*>(&WAL_MAGIC), 4);
+        pending.append(reinterpret_cast<const char*>(&payload), 4);
+        pending.append(reinterpret_cast<const char*>(&lsn), 8);
+        for (auto &[nodeIndex, image] : images) {
+            pending.append(reinterpret_cast<const char*>(&nodeIndex), sizeof(int));
+            pending.append(image, imageBytes);
+        }
+        unsigned sum = fnv1a(pending.data() + start + 16, payload);
+        pending.append(reinterpret_cast<const char*>(&sum), 4);
+    }
+
+    bool writeAll(const string &data) {
+        size_t done = 0;
+        while (done < data.size()) {
+            ssize_t n = write(fd, data.data() + done, data.size() - done);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            done += n;
+        }
+        return true;
+    }
+};
+
+// ---------------- BLOOM FILTER ----------------
+// Counting Bloom filter over every key of an index, kept next to it in
+// <index>.bloom, so that most lookups for absent keys return without
+// reading a node. It is blocked: a key hashes to one 64-byte block of 128
+// four-bit counters and bumps BLOOM_PROBES of them, so a lookup touches a
+// single cache line. Deletes count the key back down; a counter that
+// reaches 15 stays there, since it can no longer be counted down exactly.
+//   [BloomHeader, padded to 64 bytes][block]...
+// The file is mapped, so keeping it current costs no I/O of its own. It is
+// marked dirty before its first change in a session and clean again once
+// it has been synced at close. A filter left dirty (crash), made for other
+// keys or sized for far more or fewer keys than it holds is rebuilt from
+// the tree when the index is opened.
+static constexpr int BLOOM_MAGIC = 0x4d4f4c42;   // "BLOM"
+static constexpr int BLOOM_VERSION = 1;
+static constexpr int BLOOM_BLOCK = 64;
+static constexpr int BLOOM_CELLS_PER_KEY = 10;   // about 1% false positives at capacity
+static constexpr int BLOOM_PROBES = 7;
+static constexpr long long BLOOM_MIN_KEYS = 1024;
+
+struct BloomHeader {
+    int magic;
+    int version;
+    int clean;           // 1 while the file matches the index
+    int keyBytes;
+    long long blocks;
+    long long capacity;  // keys it was sized for
+    long long keys;      // keys added minus keys removed
+};
+
+static_assert(sizeof(BloomHeader) <= BLOOM_BLOCK);
+
+// MurmurHash3's 64-bit finalizer, over a key widened to 64 bits
+inline unsigned long long bloomHash(unsigned long long x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+// Counters are updated with atomic read-modify-writes on their 64-bit
+// words, so one filter serves every thread of a concurrent handle.
+class BloomFilter {
+public:
+    BloomFilter(const string &path, int keyBytes);
+    ~BloomFilter();
+
+    BloomFilter(const BloomFilter&) = delete;
+    BloomFilter& operator=(const BloomFilter&) = delete;
+
+    bool isOpen() const { return fd >= 0; }
+    // True if the file cannot be used as it is; rebuild() it first.
+    bool stale() const;
+    // Size the filter for these key hashes (with room to grow) and fill it.
+    bool rebuild(const vector<unsigned long long> &hashes);
+
+    bool mayContain(unsigned long long h) {
+        unsigned long long *b = blockOf(h);
+        unsigned long long g = h * 0x9e3779b97f4a7c15ULL;
+        for (int i = 0; i < BLOOM_PROBES; i++, g >>= 7) {
+            int c = g & 127;
+            unsigned long long word = atomic_ref<unsigned long long>(b[c >> 4]).load(memory_order_relaxed);
+            if ((word >> (c & 15) * 4 & 15) == 0) return false;
+        }
+        return true;
+    }
+    void add(unsigned long long h) { change(h, 1); }
+    void remove(unsigned long long h) { change(h, -1); }
+
+private:
+    int fd = -1;
+    int keyBytes;
+    char *base = nullptr;
+    long long mapLen = 0;
+    once_flag dirtied;
+    bool changed = false;
+
+    BloomHeader& header() const { return *reinterpret_cast<BloomHeader*>(base); }
+    unsigned long long* blockOf(unsigned long long h) const {
+        long long b = (long long)((h >> 32) * (unsigned long long)header().blocks >> 32);
+        return reinterpret_cast<unsigned long long*>(base + BLOOM_BLOCK * (b + 1));
+    }
+    void change(unsigned long long h, int delta);
+    void count(unsigned long long h, int delta);
+};
+
+// ---------------- ASYNC I/O ----------------
+// Node reads and writes submitted in batches and completed out of order,
+// so one thread can keep many of them in flight. The io_uring engine talks
+// to the kernel directly (no liburing needed); where io_uring is missing
+// or blocked (old kernel, seccomp) a small thread pool runs pread/pwrite
+// instead. Both report (tag, result) completions.
+enum class IoBackend { Auto, Uring, Threads };
+
+static constexpr int DEFAULT_QUEUE_DEPTH = 64;
+static constexpr int IO_THREADS = 4;
+
+struct IoRequest {
+    bool write;
+    int fd;
+    void *buf;
+    unsigned len;
+    long long offset;
+    unsigned long long tag;
+};
+
+struct IoCompletion {
+    unsigned long long tag;
+    int result;   // bytes transferred, or -errno
+};
+
+class IoEngine {
+public:
+    virtual ~IoEngine() = default;
+    // Queue a request; it reaches the device on the next reap() at the latest.
+    virtual void submit(const IoRequest &req) = 0;
+    // Submit what is queued and collect finished requests. With 'wait',
+    // blocks until at least one completes (if any are outstanding).
+    virtual void reap(vector<IoCompletion> &out, bool wait) = 0;
+    virtual int outstanding() const = 0;
+    virtual const char* name() const = 0;
+};
+
+#if BTREE_HAVE_URING
+class UringEngine : public IoEngine {
+public:
+    explicit UringEngine(unsigned entries) {
+        io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        ringFd = (int)syscall(__NR_io_uring_setup, entries, &p);
+        if (ringFd < 0) return;
+        if (!supportsReadWrite() || !mapRings(p)) {
+            close(ringFd);
+            ringFd = -1;
+        }
+    }
+
+    ~UringEngine() override {
+        if (sqes) munmap(sqes, sqesBytes);
+        if (cqRing && cqRing != sqRing) munmap(cqRing, cqBytes);
+        if (sqRing) munmap(sqRing, sqBytes);
+        if (ringFd >= 0) close(ringFd);
+    }
+
+    bool ok() const { return ringFd >= 0; }
+
+    void submit(const IoRequest &req) override {
+        // Never more in flight than the completion ring can hold
+        while (inFlight >= (int)entries) collect(true);
+        unsigned tail = *sqTail;
+        unsigned slot = tail & sqMask;
+        io_uring_sqe &sqe = sqes[slot];
+        memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = req.write ? IORING_OP_WRITE : IORING_OP_READ;
+        sqe.fd = req.fd;
+        sqe.addr = reinterpret_cast<unsigned long long>(req.buf);
+        sqe.len = req.len;
+        sqe.off = req.offset;
+        sqe.user_data = req.tag;
+        sqArray[slot] = slot;
+        __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+        toSubmit++;
+        inFlight++;
+    }
+
+    void reap(vector<IoCompletion> &out, bool wait) override {
+        collect(wait && ready.empty());
+        out.insert(out.end(), ready.begin(), ready.end());
+        ready.clear();
+    }
+
+    int outstanding() const override { return inFlight + (int)ready.size(); }
+    const char* name() const override { return "io_uring"; }
+
+private:
+    int ringFd = -1;
+    unsigned entries = 0;
+    void *sqRing = nullptr, *cqRing = nullptr;
+    size_t sqBytes = 0, cqBytes = 0, sqesBytes = 0;
+    io_uring_sqe *sqes = nullptr;
+    unsigned *sqTail = nullptr, *sqArray = nullptr, sqMask = 0;
+    unsigned *cqHead = nullptr, *cqTail = nullptr, cqMask = 0;
+    io_uring_cqe *cqes = nullptr;
+    unsigned toSubmit = 0;
+    int inFlight = 0;
+    vector<IoCompletion> ready;   // reaped while the submission ring was full
+
+    // IORING_OP_READ/WRITE need Linux 5.6; older kernels take the fallback.
+    bool supportsReadWrite() {
+        size_t bytes = sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op);
+        vector<char> buf(bytes, 0);
+        auto *probe = reinterpret_cast<io_uring_probe*>(buf.data());
+        if (syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_PROBE, probe, 256) < 0) return false;
+        auto has = [&](int op) { return op <= probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED); };
+        return has(IORING_OP_READ) && has(IORING_OP_WRITE);
+    }
+
+    bool mapRings(const io_uring_params &p) {
+        entries = p.sq_entries;
+        sqBytes = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cqBytes = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+        if (single) sqBytes = cqBytes = max(sqBytes, cqBytes);
+        sqRing = mmap(nullptr, sqBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+        if (sqRing == MAP_FAILED) { sqRing = nullptr; return false; }
+        cqRing = single ? sqRing
+                        : mmap(nullptr, cqBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED) { cqRing = nullptr; return false; }
+        sqesBytes = p.sq_entries * sizeof(io_uring_sqe);
+        void *s = mmap(nullptr, sqesBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+        if (s == MAP_FAILED) return false;
+        sqes = static_cast<io_uring_sqe*>(s);
+
+        char *sq = static_cast<char*>(sqRing), *cq = static_cast<char*>(cqRing);
+        sqTail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        sqMask = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+        cqHead = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        cqMask = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+        return true;
+    }
+
+    // One io_uring_enter: hand over the queued entries and, if asked, wait
+    // for a completion; then move every finished entry to 'ready'.
+    void collect(bool wait) {
+        unsigned waitFor = (wait && inFlight > 0) ? 1 : 0;
+        if (toSubmit > 0 || waitFor > 0) {
+            long n = syscall(__NR_io_uring_enter, ringFd, toSubmit, waitFor,
+                             waitFor ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+            if (n > 0) toSubmit -= min<unsigned>(toSubmit, n);
+        }
+        unsigned head = *cqHead;
+        unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+        while (head != tail) {
+            const io_uring_cqe &cqe = cqes[head & cqMask];
+            ready.push_back({cqe.user_data, cqe.res});
+            inFlight--;
+            head++;
+        }
+        __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+    }
+};
+#endif
+
+class ThreadPoolEngine : public IoEngine {
+public:
+    explicit ThreadPoolEngine(int threads) {
+        for (int i = 0; i < threads; i++) workers.emplace_back([this] { run(); });
+    }
+
+    ~ThreadPoolEngine() override {
+        {
+            lock_guard<mutex> lk(mu);
+            stopping = true;
+        }
+        work.notify_all();
+        for (thread &t : workers) t.join();
+    }
+
+    void submit(const IoRequest &req) override {
+        {
+            lock_guard<mutex> lk(mu);
+            queue.push_back(req);
+            inFlight++;
+        }
+        work.notify_one();
+    }
+
+    void reap(vector<IoCompletion> &out, bool wait) override {
+        unique_lock<mutex> lk(mu);
+        if (wait) finished.wait(lk, [&] { return !done.empty() || inFlight == 0; });
+        inFlight -= (int)done.size();
+        out.insert(out.end(), done.begin(), done.end());
+        done.clear();
+    }
+
+    int outstanding() const override {
+        lock_guard<mutex> lk(mu);
+        return inFlight;
+    }
+    const char* name() const override { return "threads"; }
+
+private:
+    mutable mutex mu;
+    condition_variable work, finished;
+    deque<IoRequest> queue;
+    vector<IoCompletion> done;
+    int inFlight = 0;   // submitted and not yet reaped
+    bool stopping = false;
+    vector<thread> workers;
+
+    void run() {
+        unique_lock<mutex> lk(mu);
+        while (true) {
+            work.wait(lk, [&] { return stopping || !queue.empty(); });
+            if (queue.empty()) return;
+            IoRequest req = queue.front();
+            queue.pop_front();
+            lk.unlock();
+            char *p = static_cast<char*>(req.buf);
+            unsigned moved = 0;
+            int result = 0;
+            while (moved < req.len) {
+                ssize_t n = req.write ? pwrite(req.fd, p + moved, req.len - moved, req.offset + moved)
+                                      : pread(req.fd, p + moved, req.len - moved, req.offset + moved);
+                if (n < 0) { result = -errno; break; }
+                if (n == 0) break;
+                moved += n;
+            }
+            lk.lock();
+            done.push_back({req.tag, result < 0 ? result : (int)moved});
+            finished.notify_one();
+        }
+    }
+};
+
+unique_ptr<IoEngine> makeIoEngine(IoBackend backend, int queueDepth);
+
+class ShadowMap;
+
+// ---------------- BUFFER POOL ----------------
+// Fixed number of in-memory frames in front of the index file.
+// pin() loads a node (or returns the cached copy) and keeps it resident
+// until the matching unpin(). Dirty frames are written back when they are
+// evicted (CLOCK policy) or when flushAll() is called. Over a mapped store
+// the pool writes through, so views of the mapping are never stale.
+//
+// With a write-ahead log attached, changes are grouped into operations
+// (beginOp/endOp). A frame changed by the running operation is not written
+// to the store until its image is in the log, so eviction skips it; at the
+// end of the operation the images are committed to the log and the frames
+// are then written back lazily like any other dirty frame. A frame changed
+// again before it was written back keeps its committed image aside, which
+// a checkpoint writes in its place.
+//
+// Hits on a shared pool do not take its mutex: a hint table maps each node
+// (by index modulo its size) to the frame it was last found in, and pin()
+// and a clean unpin() of a resident node work on that frame's atomic pin
+// count. The evictor only reuses a frame it can move from 0 pins to -1, so
+// a frame a reader has pinned keeps its node; a reader that pinned a frame
+// which turned out to hold another node lets it go and takes the locked path.
+static constexpr int DEFAULT_POOL_FRAMES = 256;
+static constexpr int POOL_HINT_SLOTS = 1024;
+
+struct Frame {
+    atomic<int> nodeIndex{-1};
+    atomic<int> pinCount{0};   // -1 while victim() reuses the frame
+    bool dirty = false;
+    atomic<bool> referenced{false}; // CLOCK second-chance bit
+    bool unlogged = false;   // changed by the running operation, not in the log yet
+    vector<char> image;      // raw node image, allocated once per frame
+    vector<char> committed;  // while unlogged: last committed image if the store lacks it
+
+    Frame(long long bytes) : image(bytes) {}
+};
+
+class BufferPool {
+public:
+    BufferPool(NodeStore &store, long long imageBytes, int capacity = DEFAULT_POOL_FRAMES)
+        : store(store), bytes(imageBytes), capacity(capacity) {}
+
+    ~BufferPool() { flushAll(); }
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    // Guard the frame table with a mutex so several threads can share the
+    // pool. Frame contents are protected by the callers' node latches.
+    void setThreadSafe(bool on) { threadSafe = on; }
+
+    // Returns the node image held in the frame; valid until unpin().
+    char* pin(int nodeIndex) {
+        if (Frame *fr = pinHinted(nodeIndex)) return fr->image.data();
+        auto lk = guard();
+        return pinLocked(nodeIndex);
+    }
+
+    // pin() without I/O: nullptr if the node is not resident.
+    char* pinIfCached(int nodeIndex) {
+        auto lk = guard();
+        auto it = table.find(nodeIndex);
+        if (it == table.end()) return nullptr;
+        Frame &fr = frames[it->second];
+        fr.pinCount++;
+        fr.referenced.store(true, memory_order_relaxed);
+        return fr.image.data();
+    }
+
+    // Cache an image read by someone else (asynchronous reads) as a clean
+    // frame. A resident frame is newer and is left alone.
+    void install(int nodeIndex, const char *image) {
+        auto lk = guard();
+        if (table.count(nodeIndex)) return;
+        int slot = victim();
+        Frame &fr = frames[slot];
+        memcpy(fr.image.data(), image, bytes);
+        store.stats().bump(Counter::NodeReads);
+        fr.nodeIndex = nodeIndex;
+        fr.dirty = false;
+        fr.referenced.store(true, memory_order_relaxed);
+        fr.pinCount.store(0, memory_order_release);
+        table[nodeIndex] = slot;
+        hintOf(nodeIndex).store(&fr, memory_order_release);
+    }
+
+    // Number of node images the pool has written to the store so far; an
+    // asynchronous read issued before it last changed may be stale.
+    unsigned long long storeWrites() const { return writes; }
+    IndexStats& stats() { return store.stats(); }
+
+    // Structure generation: bumped by every split, borrow, merge and root
+    // change. Unlike the counters in stats() it is never reset, so while it
+    // stays the same every node on a path found earlier still has the same
+    // index and place.
+    void reshaped() { shapes.fetch_add(1, memory_order_release); }
+    unsigned long long shape() const { return shapes.load(memory_order_acquire); }
+    long long imageSize() const { return bytes; }
+    template<class K, class V>
+    bool fits(const BasicNode<K, V> &n) const { return store.fits(n); }
+    template<class K, class V>
+    bool fitsWith(const BasicNode<K, V> &n, const K &key, const V &ref) const { return store.fitsWith(n, key, ref); }
+    int sureEntries() const { return store.sureEntries(); }
+
+    // pin() for a caller about to change the image. Under a log the frame
+    // joins the running operation right away, so neither eviction nor a
+    // checkpoint can pick up a half-written image.
+    char* pinForWrite(int nodeIndex) {
+        auto lk = guard();
+        char *p = pinLocked(nodeIndex);
+        if (log) markDirty(frames[table[nodeIndex]]);
+        return p;
+    }
+
+    void unpin(int nodeIndex, bool dirty) {
+        if (!dirty) {
+            // A pinned frame keeps its node, so the hinted frame is the one
+            // if it holds the node.
+            Frame *fr = hintOf(nodeIndex).load(memory_order_acquire);
+            if (fr && fr->nodeIndex.load(memory_order_acquire) == nodeIndex && fr->pinCount.load() > 0) {
+                fr->pinCount.fetch_sub(1, memory_order_release);
+                return;
+            }
+        }
+        auto lk = guard();
+        auto it = table.find(nodeIndex);
+        if (it == table.end()) return;
+        Frame &fr = frames[it->second];
+        if (fr.pinCount > 0) fr.pinCount--;
+        if (dirty) markDirty(fr);
+    }
+
+    // Write a whole node without loading it first: updates the frame if the
+    // node is cached, otherwise goes straight to the store. False if the
+    // store refused it.
+    bool put(int nodeIndex, const char *image) {
+        auto lk = guard();
+        auto it = table.find(nodeIndex);
+        if (it != table.end()) {
+            Frame &fr = frames[it->second];
+            if (log) markDirty(fr);   // first, so a committed image is kept
+            memcpy(fr.image.data(), image, bytes);
+            if (!log) markDirty(fr);
+            return true;
+        }
+        if (!store.writeImage(nodeIndex, image)) return false;
+        wrote(1);
+        return true;
+    }
+
+    // Store calls that may race with frame I/O go through the pool.
+    bool extend(long long newSize) {
+        auto lk = guard();
+        return store.extend(newSize);
+    }
+    void syncStore() {
+        auto lk = guard();
+        store.flush();
+        store.sync();
+    }
+
+    NodeStore& storage() { return store; }
+
+    void attachLog(WriteAheadLog *wal) { log = wal; }
+    bool logging() const { return log != nullptr; }
+    // The log could not take an operation. Frames changed since stay
+    // unlogged, so only their committed images ever reach the store.
+    bool logFailed() const { return log && log->failed(); }
+
+    // Copy-on-write bookkeeping of the handle, if it has any.
+    void attachShadow(ShadowMap *map) { shadowMap = map; }
+    ShadowMap* shadow() const { return shadowMap; }
+
+    // Operations nest per thread; only the outermost endOp() commits.
+    void beginOp() {
+        auto lk = guard();
+        txnOf().depth++;
+    }
+    void endOp() {
+        auto lk = guard();
+        Txn &t = txnOf();
+        if (--t.depth == 0) commit(lk, t);
+    }
+
+    // Write back every logged frame, make the store durable, then empty the log.
+    void checkpoint() {
+        auto lk = guard();
+        checkpoint(lk);
+    }
+
+    // Write every dirty frame back in file order, then flush once.
+    void flushAll() {
+        auto lk = guard();
+        flushAllLocked();
+    }
+
+    // flushAll() with all the writes in flight at once on an I/O engine.
+    void flushAll(IoEngine &io) {
+        auto lk = guard();
+        int fd = store.descriptor();
+        if (fd < 0) {
+            flushAllLocked();
+            return;
+        }
+        store.flush();
+        vector<int> slots = dirtyInOrder();
+        for (int i : slots) {
+            long long off = (long long)frames[i].nodeIndex * store.slotStride();
+            io.submit({true, fd, durableImage(frames[i]), (unsigned)bytes, off, (unsigned long long)i});
+        }
+        vector<IoCompletion> done;
+        while (done.size() < slots.size()) io.reap(done, true);
+        for (IoCompletion &c : done) {
+            if (c.result == bytes) written(frames[c.tag]);
+        }
+        wrote(slots.size());
+    }
+
+private:
+    // Changes of one thread's running operation.
+    struct Txn {
+        int depth = 0;
+        vector<int> nodes;
+    };
+
+    NodeStore &store;
+    long long bytes;                 // size of every frame's image
+    int capacity;
+    deque<Frame> frames;             // deque keeps pinned references stable
+    unordered_map<int, int> table;   // nodeIndex -> frame slot
+    array<atomic<Frame*>, POOL_HINT_SLOTS> hints{};   // nodeIndex -> frame it was last in, maybe stale
+    int hand = 0;
+    unsigned long long writes = 0;
+    atomic<unsigned long long> shapes{0};
+    WriteAheadLog *log = nullptr;
+    ShadowMap *shadowMap = nullptr;
+    unordered_map<thread::id, Txn> txns;
+    bool threadSafe = false;
+    mutex mu;
+    condition_variable idle;         // signalled when a commit or checkpoint finishes
+    int committing = 0;              // commits waiting on the log
+    bool checkpointing = false;
+
+    void wrote(size_t images) {
+        writes += images;
+        store.stats().bump(Counter::NodeWrites, images);
+    }
+
+    unique_lock<mutex> guard() {
+        return threadSafe ? unique_lock<mutex>(mu) : unique_lock<mutex>();
+    }
+
+    Txn& txnOf() { return txns[this_thread::get_id()]; }
+
+    atomic<Frame*>& hintOf(int nodeIndex) { return hints[(unsigned)nodeIndex % POOL_HINT_SLOTS]; }
+
+    // Pin a resident node through its hint without the mutex; nullptr if
+    // the hint is stale or the frame is being reused.
+    Frame* pinHinted(int nodeIndex) {
+        Frame *fr = hintOf(nodeIndex).load(memory_order_acquire);
+        if (!fr || fr->nodeIndex.load(memory_order_relaxed) != nodeIndex) return nullptr;
+        int pins = fr->pinCount.load(memory_order_relaxed);
+        do {
+            if (pins < 0) return nullptr;
+        } while (!fr->pinCount.compare_exchange_weak(pins, pins + 1, memory_order_acquire));
+        if (fr->nodeIndex.load(memory_order_relaxed) != nodeIndex) {
+            fr->pinCount.fetch_sub(1, memory_order_release);
+            return nullptr;
+        }
+        fr->referenced.store(true, memory_order_relaxed);
+        return fr;
+    }
+
+    char* pinLocked(int nodeIndex) {
+        auto it = table.find(nodeIndex);
+        if (it != table.end()) {
+            Frame &fr = frames[it->second];
+            fr.pinCount++;
+            fr.referenced.store(true, memory_order_relaxed);
+            hintOf(nodeIndex).store(&fr, memory_order_release);
+            return fr.image.data();
+        }
+        int slot = victim();
+        Frame &fr = frames[slot];
+        store.readImage(nodeIndex, fr.image.data());
+        store.stats().bump(Counter::NodeReads);
+        fr.nodeIndex = nodeIndex;
+        fr.dirty = false;
+        fr.referenced.store(true, memory_order_relaxed);
+        fr.pinCount.store(1, memory_order_release);
+        table[nodeIndex] = slot;
+        hintOf(nodeIndex).store(&fr, memory_order_release);
+        return fr.image.data();
+    }
+
+    // False if a dirty image could not be written back: the frame stays.
+    bool evict(Frame &fr) {
+        if (fr.nodeIndex == -1) return true;
+        if (fr.dirty) {
+            if (!store.writeImage(fr.nodeIndex, fr.image.data())) return false;
+            wrote(1);
+        }
+        table.erase(fr.nodeIndex);
+        return true;
+    }
+
+    // Under a log, call it before the image changes.
+    void markDirty(Frame &fr) {
+        if (log) {
+            if (!fr.unlogged) {
+                // Still dirty: the image only the log and this frame hold
+                if (fr.dirty) fr.committed = fr.image;
+                txnOf().nodes.push_back(fr.nodeIndex);
+            }
+            fr.unlogged = true;
+            fr.dirty = true;
+        } else if (store.mapped() && store.writeImage(fr.nodeIndex, fr.image.data())) {
+            wrote(1);
+        } else {
+            fr.dirty = true;   // a mapped write that failed is retried on write-back
+        }
+    }
+
+    // Slots of the frames to write back, in file order. A frame the running
+    // operation is changing goes back with its committed image, if any.
+    vector<int> dirtyInOrder() {
+        vector<int> dirtySlots;
+        for (int i = 0; i < (int)frames.size(); i++) {
+            Frame &fr = frames[i];
+            if (fr.nodeIndex != -1 && fr.dirty && (!fr.unlogged || !fr.committed.empty())) dirtySlots.push_back(i);
+        }
+        sort(dirtySlots.begin(), dirtySlots.end(), [&](int a, int b) {
+            return frames[a].nodeIndex < frames[b].nodeIndex;
+        });
+        return dirtySlots;
+    }
+
+    char* durableImage(Frame &fr) {
+        return fr.unlogged ? fr.committed.data() : fr.image.data();
+    }
+
+    // The store has the frame's durable image; an unlogged frame stays dirty.
+    void written(Frame &fr) {
+        if (fr.unlogged) fr.committed.clear();
+        else fr.dirty = false;
+    }
+
+    void flushAllLocked() {
+        vector<int> dirtySlots = dirtyInOrder();
+        if (dirtySlots.empty()) return;
+        int done = 0;
+        for (int i : dirtySlots) {
+            if (!store.writeImage(frames[i].nodeIndex, durableImage(frames[i]))) continue;
+            written(frames[i]);
+            done++;
+        }
+        wrote(done);
+        store.flush();
+    }
+
+    // Log the operation's images; once durable, mapped stores get them right
+    // away, file stores on eviction or checkpoint. The pool lock is dropped
+    // while waiting on the log so other threads' commits share its fsync.
+    // The frames stay put meanwhile: they are unlogged (never evicted) and
+    // still latched by the committing operation.
+    void commit(unique_lock<mutex> &lk, Txn &t) {
+        if (!log || t.nodes.empty()) return;
+        while (checkpointing) idle.wait(lk);
+        vector<int> nodes;
+        nodes.swap(t.nodes);
+        vector<pair<int, const char*>> images;
+        for (int idx : nodes) images.push_back({idx, frames[table[idx]].image.data()});
+        committing++;
+        bool ok;
+        if (lk.owns_lock()) {
+            lk.unlock();
+            ok = log->commit(images, bytes);
+            lk.lock();
+        } else {
+            ok = log->commit(images, bytes);
+        }
+        committing--;
+        if (!ok) {
+            idle.notify_all();
+            return;
+        }
+        for (int idx : nodes) {
+            Frame &fr = frames[table[idx]];
+            fr.unlogged = false;
+            fr.committed.clear();
+            if (store.mapped() && store.writeImage(idx, fr.image.data())) {
+                fr.dirty = false;
+                wrote(1);
+            }
+        }
+        idle.notify_all();
+        if (log->size() > WAL_CHECKPOINT_BYTES) checkpoint(lk);
+    }
+
+    // Commits in flight are let through first so none lands in the log
+    // after it has been truncated; new ones wait until it is done.
+    void checkpoint(unique_lock<mutex> &lk) {
+        if (!log || checkpointing) return;
+        commit(lk, txnOf());
+        checkpointing = true;
+        while (committing > 0) idle.wait(lk);
+        flushAllLocked();
+        store.sync();
+        log->truncate();
+        checkpointing = false;
+        idle.notify_all();
+    }
+
+    // The frame returned is claimed (pin count -1, or fresh at 0) and its
+    // old node written back; the caller sets the pin count once it holds
+    // the new node.
+    int victim() {
+        if ((int)frames.size() < capacity) {
+            frames.emplace_back(bytes);
+            return (int)frames.size() - 1;
+        }
+        // Two sweeps are enough to clear every reference bit once.
+        for (int step = 0; step < 2 * (int)frames.size(); step++) {
+            Frame &fr = frames[hand];
+            int slot = hand;
+            hand = (hand + 1) % (int)frames.size();
+            if (fr.pinCount.load() > 0 || fr.unlogged) continue;
+            if (fr.referenced.load(memory_order_relaxed)) { fr.referenced.store(false, memory_order_relaxed); continue; }
+            int idle = 0;   // a hinted reader may have pinned it since
+            if (!fr.pinCount.compare_exchange_strong(idle, -1)) continue;
+            if (evict(fr)) return slot;
+            fr.pinCount.store(0, memory_order_release);   // stays dirty for a later try
+        }
+        // Every frame is pinned, unlogged or cannot be written back: go over
+        // budget rather than fail the operation.
+        frames.emplace_back(bytes);
+        return (int)frames.size() - 1;
+    }
+};
+
+// ---------------- LATCHES ----------------
+// One reader/writer latch per node for handles shared between threads.
+// Latches are created in chunks on first use and never move, so finding
+// one takes no lock once its chunk exists.
+//
+// Each latch also carries a version for optimistic readers, which take no
+// latch at all: the version is odd while a writer holds the node, and
+// moves on to a new even value when the writer lets go. A reader that saw
+// the same even version before and after reading a node read a stable
+// image; otherwise it starts over.
+struct Latch {
+    shared_mutex mu;
+    atomic<unsigned long long> version{0};
+};
+
+class LatchTable {
+public:
+    LatchTable() {
+        dirs.push_back(make_unique<Dir>(64));
+        dir.store(dirs.back().get());
+    }
+
+    LatchTable(const LatchTable&) = delete;
+    LatchTable& operator=(const LatchTable&) = delete;
+
+    Latch& of(int nodeIndex) {
+        int c = nodeIndex / CHUNK_LATCHES;
+        Dir *d = dir.load(memory_order_acquire);
+        if (c < d->size) {
+            Chunk *chunk = d->chunks[c].load(memory_order_acquire);
+            if (chunk) return (*chunk)[nodeIndex % CHUNK_LATCHES];
+        }
+        return create(nodeIndex);
+    }
+
+    // Version of a node once no writer holds it.
+    unsigned long long stableVersion(int nodeIndex) {
+        atomic<unsigned long long> &v = of(nodeIndex).version;
+        unsigned long long seen = v.load(memory_order_acquire);
+        while (seen & 1) {
+            this_thread::yield();
+            seen = v.load(memory_order_acquire);
+        }
+        return seen;
+    }
+
+    // True if nothing was written to the node since stableVersion() gave 'seen'.
+    bool unchanged(int nodeIndex, unsigned long long seen) {
+        atomic_thread_fence(memory_order_acquire);
+        return of(nodeIndex).version.load(memory_order_relaxed) == seen;
+    }
+
+private:
+    static constexpr int CHUNK_LATCHES = 1024;
+    using Chunk = array<Latch, CHUNK_LATCHES>;
+
+    // Chunk directory; replaced by a larger copy when the file outgrows it.
+    // Old copies are kept because a reader may still be looking at one.
+    struct Dir {
+        int size;
+        unique_ptr<atomic<Chunk*>[]> chunks;
+        explicit Dir(int size) : size(size), chunks(new atomic<Chunk*>[size]) {
+            for (int i = 0; i < size; i++) chunks[i] = nullptr;
+        }
+    };
+
+    atomic<Dir*> dir;
+    mutex createMu;
+    vector<unique_ptr<Dir>> dirs;
+    vector<unique_ptr<Chunk>> owned;
+
+    Latch& create(int nodeIndex) {
+        lock_guard<mutex> lk(createMu);
+        int c = nodeIndex / CHUNK_LATCHES;
+        Dir *d = dir.load();
+        if (c >= d->size) {
+            int size = d->size;
+            while (size <= c) size *= 2;
+            auto bigger = make_unique<Dir>(size);
+            for (int i = 0; i < d->size; i++) bigger->chunks[i] = d->chunks[i].load();
+            dirs.push_back(std::move(bigger));
+            d = dirs.back().get();
+            dir.store(d, memory_order_release);
+        }
+        if (!d->chunks[c].load()) {
+            owned.push_back(make_unique<Chunk>());
+            d->chunks[c].store(owned.back().get(), memory_order_release);
+        }
+        return (*d->chunks[c].load())[nodeIndex % CHUNK_LATCHES];
+    }
+};
+
+// The latches one operation holds, all shared (readers) or all exclusive
+// (writers). Whatever is still held is released when the set goes out of
+// scope; writers declare it before their OpScope so changed nodes stay
+// latched until the operation is in the log. Without a table (handle not
+// opened for concurrent use) every call is a no-op.
+//
+// Exclusive latches make the node's version odd. Ancestors let go early by
+// crabbing were never written, so they get their old version back; the
+// rest get a new one when released.
+class LatchSet {
+public:
+    LatchSet(LatchTable *table, bool exclusive) : table(table), exclusive(exclusive) {}
+    ~LatchSet() {
+        for (int idx : held) release(idx, true);
+    }
+
+    LatchSet(const LatchSet&) = delete;
+    LatchSet& operator=(const LatchSet&) = delete;
+
+    bool active() const { return table != nullptr; }
+    bool isExclusive() const { return exclusive; }
+
+    void lock(int nodeIndex) {
+        if (!table || find(held.begin(), held.end(), nodeIndex) != held.end()) return;
+        Latch &l = table->of(nodeIndex);
+        if (exclusive) {
+            l.mu.lock();
+            l.version.fetch_add(1, memory_order_relaxed);
+            atomic_thread_fence(memory_order_release);
+        } else {
+            l.mu.lock_shared();
+        }
+        held.push_back(nodeIndex);
+    }
+
+    void unlock(int nodeIndex) {
+        auto it = find(held.begin(), held.end(), nodeIndex);
+        if (it == held.end()) return;
+        release(nodeIndex, true);
+        held.erase(it);
+    }
+
+    // Crabbing: once 'keep' is latched and known safe, nothing above it can
+    // change, so the rest of the path (unwritten so far) is let go.
+    void unlockAllBut(int keep) {
+        for (int idx : held) if (idx != keep) release(idx, false);
+        bool kept = find(held.begin(), held.end(), keep) != held.end();
+        held.clear();
+        if (kept) held.push_back(keep);
+    }
+
+private:
+    LatchTable *table;
+    bool exclusive;
+    vector<int> held;
+
+    void release(int nodeIndex, bool written) {
+        Latch &l = table->of(nodeIndex);
+        if (!exclusive) {
+            l.mu.unlock_shared();
+            return;
+        }
+        if (written) l.version.fetch_add(1, memory_order_release);
+        else l.version.fetch_sub(1, memory_order_release);
+        l.mu.unlock();
+    }
+};
+
+template<class K, class V> BasicNode<K, V> readNode(BufferPool &bp, int nodeIndex, int m);
+template<class K, class V> void writeAtNode(BufferPool &bp, int nodeIndex, const BasicNode<K, V> &n, int m);
+template<class K, class V, class Compare>
+void updateParentMax(BufferPool &bp, int parentIndx, int childIndx, const K &newMax, int m, Compare cmp);
+template<class K, class V, class Compare>
+void propagateMaxUp(BufferPool &bp, const vector<int> &ancestors, int childIdx, int m, Compare cmp);
+
+// ---------------- REQUIRED FUNCTIONS ----------------
+
+// The free list only touches node heads, so it works for any layout. Its
+// latch (node 0's, which also covers the free nodes themselves) is kept
+// until the operation is in the log, like any node it changed. To keep
+// that deadlock-free it is always the last latch an operation takes:
+// splits latch nothing after allocating, and merges free their nodes once
+// rebalancing is done.
+void freeNode(BufferPool &bp, int idx, LatchSet &latches);
+
+// ---------------- FILE GROWTH ----------------
+// When the free list runs dry the file grows by an extent that doubles with
+// the file (within limits), reserved up front with fallocate. The new nodes
+// go on the free list in ascending order so consecutive allocations are
+// physically adjacent.
+static constexpr int MIN_EXTENT_NODES = 64;
+static constexpr int MAX_EXTENT_NODES = 1 << 16;
+// Nodes within one allocation group count as "near" each other
+static constexpr int ALLOC_GROUP_NODES = 64;
+// How far down the free list allocateNode looks for a node near the hint
+static constexpr int ALLOC_SCAN_LIMIT = 16;
+
+bool growFile(BufferPool &bp, FileHeader &head);
+int allocateNode(BufferPool &bp, LatchSet &latches, int near = -1);
+
+// ---------------- SHADOW PAGING ----------------
+// On a copy-on-write handle a writer never changes a node that a reader
+// can reach. Its first write to such a node goes to a copy taken off the
+// free list instead; when the operation ends, the parents of the copies
+// are copied in turn up to the root, and the new root is published in the
+// header and to readers at once. Inside the operation the engine keeps
+// using the node numbers it read, with 1 standing for the root wherever
+// it lives, and the map resolves them to slots. Slot 1 itself is never
+// reused once the root has moved away from it.
+//
+// Readers pin a version, which is just a root. A replaced node is retired
+// with the version that replaced it and goes back to the free list, at the
+// start of a later write, once no pin of an older version is left. Nodes
+// retired when the process dies are not reclaimed.
+class ShadowMap {
+public:
+    explicit ShadowMap(int root) : published(root) {}
+
+    // Register a reader of the current version: returns its root and version.
+    pair<int, unsigned long long> pin() {
+        lock_guard<mutex> lk(mu);
+        readers[version]++;
+        return {published.load(memory_order_relaxed), version};
+    }
+    // Another reader of a version that is already pinned.
+    void repin(unsigned long long v) {
+        lock_guard<mutex> lk(mu);
+        readers[v]++;
+    }
+    void unpin(unsigned long long v) {
+        lock_guard<mutex> lk(mu);
+        if (--readers[v] == 0) readers.erase(v);
+    }
+
+    // Writers take turns. Between lockWriter() and startOp() the writer may
+    // change slots directly (reclaiming); after it, it works on copies.
+    void lockWriter() { writer.lock(); }
+    void startOp() { owner.store(this_thread::get_id(), memory_order_relaxed); }
+    // Make 'root' the current version and let the next writer in.
+    void publish(int root) {
+        {
+            lock_guard<mutex> lk(mu);
+            published.store(root, memory_order_relaxed);
+            version++;
+        }
+        moved.clear();
+        fresh.clear();
+        freed.clear();
+        parents.clear();
+        owner.store(thread::id(), memory_order_relaxed);
+        writer.unlock();
+    }
+    // Whether the calling thread is inside a copy-on-write operation.
+    bool writing() const { return owner.load(memory_order_relaxed) == this_thread::get_id(); }
+
+    // Writer side: where a node lives now and what the operation made.
+    int slotOf(int nodeIndex) const {
+        auto it = moved.find(nodeIndex);
+        if (it != moved.end()) return it->second;
+        return nodeIndex == 1 ? published.load(memory_order_relaxed) : nodeIndex;
+    }
+    bool isFresh(int slot) const { return fresh.count(slot) > 0; }
+    void markFresh(int slot) { fresh.insert(slot); }
+    void moveTo(int nodeIndex, int slot) {
+        retire(slotOf(nodeIndex));
+        moved[nodeIndex] = slot;
+    }
+    void forget(int nodeIndex, int slot) {
+        moved.erase(nodeIndex);
+        fresh.erase(slot);
+        freed.insert(nodeIndex);
+    }
+    bool wasFreed(int nodeIndex) const { return freed.count(nodeIndex) > 0; }
+    void retire(int slot) {
+        if (slot != 1) retired.push_back({version + 1, slot});
+    }
+    void setParent(int child, int parent) { parents[child] = parent; }
+    int parentOf(int nodeIndex) const {
+        auto it = parents.find(nodeIndex);
+        return it == parents.end() ? -1 : it->second;
+    }
+    const unordered_map<int, int>& movedNodes() const { return moved; }
+    const unordered_set<int>& freshSlots() const { return fresh; }
+
+    // Retired slots that no pinned version can reach any more.
+    vector<int> takeReclaimable() {
+        lock_guard<mutex> lk(mu);
+        unsigned long long oldest = readers.empty() ? version : readers.begin()->first;
+        vector<int> out;
+        auto keep = partition(retired.begin(), retired.end(), [&](auto &r) { return r.first > oldest; });
+        for (auto it = keep; it != retired.end(); ++it) out.push_back(it->second);
+        retired.erase(keep, retired.end());
+        return out;
+    }
+
+private:
+    mutex writer;
+    mutex mu;                                  // readers, version and published
+    atomic<int> published;
+    unsigned long long version = 0;            // changed by the writer under mu
+    map<unsigned long long, int> readers;      // version -> pins
+    atomic<thread::id> owner{};
+    unordered_map<int, int> moved;             // node -> its copy in this operation
+    unordered_set<int> fresh;                  // slots allocated by this operation
+    unordered_set<int> freed;                  // nodes this operation freed
+    unordered_map<int, int> parents;           // child -> internal node it was read in
+    vector<pair<unsigned long long, int>> retired;   // (replacing version, slot)
+};
+
+// Slot of the node the running writer knows as nodeIndex.
+inline int shadowSlot(BufferPool &bp, int nodeIndex) {
+    ShadowMap *map = bp.shadow();
+    return map && map->writing() ? map->slotOf(nodeIndex) : nodeIndex;
+}
+// Slot the running writer may overwrite for nodeIndex, copying it first
+// if readers can reach it.
+int shadowWritable(BufferPool &bp, int nodeIndex);
+// Free the retired slots no snapshot needs; called by a writer before startOp().
+void reclaimRetired(BufferPool &bp);
+// Bring the root of a file last written copy-on-write back to Node 1
+// and relink its leaf chain.
+template<class K, class V> void homeRoot(BufferPool &bp, int m);
+template<class K, class V> int publishShadow(BufferPool &bp, int m);
+
+// A pinned version; without a shadow map, the live tree rooted at Node 1.
+class SnapshotPin {
+public:
+    SnapshotPin() = default;
+    explicit SnapshotPin(ShadowMap *map) : map(map) {
+        if (map) tie(root, version) = map->pin();
+    }
+    SnapshotPin(const SnapshotPin &o) : root(o.root), version(o.version), map(o.map) {
+        if (map) map->repin(version);
+    }
+    SnapshotPin(SnapshotPin &&o) noexcept : root(o.root), version(o.version), map(o.map) { o.map = nullptr; }
+    SnapshotPin& operator=(SnapshotPin o) noexcept {
+        swap(root, o.root);
+        swap(version, o.version);
+        swap(map, o.map);
+        return *this;
+    }
+    ~SnapshotPin() {
+        if (map) map->unpin(version);
+    }
+
+    int root = 1;
+    unsigned long long version = 0;
+
+private:
+    ShadowMap *map = nullptr;
+};
+
+template<class K, class V, class Compare>
+void solveUnderflow(BufferPool &bp, int currentIdx, vector<int>& path, int m, LatchSet &latches, Compare cmp);
+template<class K = int, class V = int>
+FileHeader makeHeader(int m, int pageBytes, int nodeCount, int freeHead,
+                      NodeFormat format = NodeFormat::Plain);
+
+// The index file is created for one key and ref type; opening it as
+// another fails. int/int unless given.
+template<class K = int, class V = int>
+void CreateIndexFileFile(char* filename, int numOfRecords, int m, int pageBytes = 0,
+                         NodeFormat format = NodeFormat::Plain);
+vector<int> groupSizes(int count, int perNode, int minKeys);
+
+// Where the nodes of a tree written from scratch go. The root is Node 1
+// in every order.
+enum class NodeOrder {
+    LeavesFirst,    // leaves from Node 2 in key order, then each level above them
+    BreadthFirst,   // level by level down from the root; the leaves last, in key order
+    VanEmdeBoas,    // the top half of the levels, then each subtree below them, recursively
+};
+
+// Slot of every node of a tree shaped by sizes: sizes[l][g] entries in
+// node g of level l, leaves on level 0 and the root alone on the last.
+vector<vector<int>> placeNodes(const vector<vector<int>> &sizes, NodeOrder order);
+
+// Where n entries split, the left node keeping [0, mid), when the entry at
+// position at is new and run says how it carries on a run (see
+// SplitPolicy; 0 splits in the middle).
+int splitPoint(int n, int at, int run, bool leaf);
+
+template<class K, class V, class Compare = less<K>>
+bool BulkLoadIndexFile(char* filename, int numOfRecords, int m,
+                       vector<pair<K, V>> records, double fillFactor = 1.0, int pageBytes = 0,
+                       NodeFormat format = NodeFormat::Plain);
+
+// Offline: no handle may have the file open.
+template<class K, class V, class Compare = less<K>>
+bool CompactIndexFile(char* filename, double fillFactor = 1.0, NodeOrder order = NodeOrder::BreadthFirst);
+
+//--------------------- OPRATIONS ----------------------
+
+template<class K, class V, class Compare = less<K>>
+class BasicBTreeIndex;
+
+// Ordered iterator over the keys in [lo, hi]. It starts at the leaf that
+// holds lo and then follows the leaf chain, one node read per leaf.
+// Writes to the index invalidate an open scan. On a concurrent handle each
+// leaf is copied under its latch and the next one is found by a fresh
+// descent for the keys past the current leaf's upper bound instead (a
+// chained leaf can be merged away once its latch is dropped); keys present
+// for the whole scan are then returned exactly once. On a copy-on-write
+// handle a scan reads the version that was current when it was opened,
+// by descents as well, and writes do not disturb it.
+template<class K, class V, class Compare = less<K>>
+class BasicRangeScan {
+public:
+    BasicRangeScan(BasicBTreeIndex<K, V, Compare> &idx, const K &lo, const K &hi, SnapshotPin pin = {});
+
+    // Produces the next (key, ref) pair; false once the range is exhausted.
+    bool next(K &key, V &ref);
+
+private:
+    BasicBTreeIndex<K, V, Compare> *idx;
+    int m;
+    BasicNode<K, V> leaf;
+    int leafIdx = -1;
+    int pos = 0;
+    K hi;
+    optional<K> bound;   // largest key routed to the current leaf, none on the right edge
+    SnapshotPin pin;
+
+    void load(const K &from, bool after);
+};
+
+// Where a full node splits. Even splits in the middle. Keys arriving in
+// order would then leave every node behind them half full for good, so
+// the other policies split next to the gap the keys are filling and keep
+// the node that takes the rest of them as empty as they can: Append for
+// keys past the end of the rightmost leaf, Sequential also for ascending
+// or descending runs anywhere (an insert next to the last one into the
+// same node). Parents split the same way.
+enum class SplitPolicy { Even, Append, Sequential };
+
+// Long-lived handle on one index file. The file is opened once, the header
+// (Node 0) and the root (Node 1) stay pinned in the buffer pool, and every
+// operation reuses the same pool instead of reopening the file.
+struct IndexOptions {
+    StorageMode storage = StorageMode::File;
+    bool writeAheadLog = false;   // log each operation to <index>.wal before it reaches the file
+    bool concurrent = false;      // share the handle between threads (per-node latches)
+    bool copyOnWrite = false;     // never change a reachable node in place; enables snapshot() (plain files only)
+    bool bloomFilter = false;     // create <index>.bloom if missing; a file that has one always uses it
+    bool deferredDeletes = false; // erase leaves a tombstone; maintenance removes it and rebalances later
+    SplitPolicy split = SplitPolicy::Even;
+};
+
+// Deferred deletes: queued tombstones are purged once this many are waiting,
+// and at least this often by a concurrent handle's maintenance thread.
+static constexpr int PURGE_BATCH = 1024;
+static constexpr chrono::milliseconds PURGE_INTERVAL{20};
+
+// Read-only view of a copy-on-write index as of the last operation that
+// had finished when it was taken. Writers carry on meanwhile; the nodes it
+// reads are not reused until it (and every scan opened on it) is gone.
+// Destroy it before the index handle.
+template<class K, class V, class Compare = less<K>>
+class BasicSnapshot {
+public:
+    // False when taken from a handle without copyOnWrite.
+    bool isOpen() const { return open; }
+    unsigned long long version() const { return pin.version; }
+
+    V search(const K &RecordID);
+    vector<pair<K, V>> scan(const K &lo, const K &hi);
+    BasicRangeScan<K, V, Compare> openScan(const K &lo, const K &hi);
+
+private:
+    friend class BasicBTreeIndex<K, V, Compare>;
+    BasicSnapshot(BasicBTreeIndex<K, V, Compare> &idx, ShadowMap *map) : idx(&idx), pin(map), open(map) {}
+
+    BasicBTreeIndex<K, V, Compare> *idx;
+    SnapshotPin pin;
+    bool open;
+};
+
+// One logical operation for the write-ahead log: everything changed inside
+// the scope is committed as a single record when it ends.
+class OpScope {
+public:
+    explicit OpScope(BufferPool &bp) : bp(bp) { bp.beginOp(); }
+    ~OpScope() { bp.endOp(); }
+
+private:
+    BufferPool &bp;
+};
+
+// Keys are any trivially copyable type ordered by Compare (equal means
+// neither orders before the other). Refs are integral and at least int
+// wide, since internal nodes keep child node indices in them; a lookup
+// that misses returns NOT_FOUND, -1 for signed refs.
+//
+// NOT_FOUND is not a ref that can be stored: a leaf entry holding it is a
+// tombstone. With deferredDeletes, erase only turns the entry into one,
+// which costs a single leaf write and no rebalancing. Lookups read it as
+// the miss it stands for and scans skip it; inserting the key again reuses
+// it. The keys are queued, and maintain() removes their tombstones in
+// batches and merges or borrows for the leaves left short. A concurrent
+// handle runs maintain() on its own thread; otherwise erase runs it once
+// PURGE_BATCH tombstones are waiting. Closing the handle purges the rest.
+// Tombstones left by a crash are not queued again; they stay until their
+// key is inserted again or erased by a handle without deferred deletes.
+//
+// With writeAheadLog, an operation the log could not make durable fails:
+// insert returns -1, erase false, and the batch calls and maintain() -1.
+// So does every later write on the handle. Reopening the file replays what was logged.
+template<class K, class V, class Compare>
+class BasicBTreeIndex {
+    static_assert(is_trivially_copyable_v<K>, "keys are stored as raw bytes");
+    static_assert(is_integral_v<V> && sizeof(V) >= sizeof(int), "refs also hold child node indices");
+
+public:
+    using NodeType = BasicNode<K, V>;
+    using Layout = NodeLayout<K, V>;
+    static constexpr V NOT_FOUND = V(-1);
+
+    explicit BasicBTreeIndex(const char* filename, IndexOptions opts = {});
+    BasicBTreeIndex(const char* filename, StorageMode mode) : BasicBTreeIndex(filename, IndexOptions{mode}) {}
+
+    ~BasicBTreeIndex() {
+        if (maintainer.joinable()) {
+            {
+                lock_guard<mutex> lk(pendingLock);
+                stopping = true;
+            }
+            pendingReady.notify_all();
+            maintainer.join();
+        }
+        maintain();
+        if (shadow) {
+            WriteScope last(*this);   // reclaims what the last writes retired
+        }
+        bp.checkpoint();
+        bp.flushAll();   // before the totals are taken; the pool's own flush finds nothing left
+        sessionStats().add(store->stats());
+    }
+
+    BasicBTreeIndex(const BasicBTreeIndex&) = delete;
+    BasicBTreeIndex& operator=(const BasicBTreeIndex&) = delete;
+
+    bool isOpen() const { return store->isOpen() && m > 0; }
+    int order() const { return m; }
+    // Whether lookups go through a Bloom filter. Only integral keys in
+    // their natural order are filtered.
+    bool hasFilter() const { return bloom != nullptr; }
+    // Counters and latency histograms of this handle. Node reads count
+    // pool misses only: mapped stores serve lookups from the mapping.
+    IndexStats& stats() { return store->stats(); }
+
+    V search(const K &RecordID);
+    void multiSearch(span<const K> ids, span<V> refsOut);
+    int insert(const K &RecID, const V &Ref);
+    bool erase(const K &RecordID);
+    int insertBatch(vector<pair<K, V>> records);
+    int eraseBatch(vector<K> ids);
+    // Purge the queued tombstones now and fix the underflows this leaves.
+    // Returns the number purged, or -1 if the log failed.
+    int maintain();
+    vector<pair<K, V>> scan(const K &lo, const K &hi);
+    BasicRangeScan<K, V, Compare> openScan(const K &lo, const K &hi);
+    // Consistent view for long reads; needs copyOnWrite.
+    BasicSnapshot<K, V, Compare> snapshot() { return BasicSnapshot<K, V, Compare>(*this, shadow.get()); }
+    // Not latched: only call it while no writer is running.
+    void display(ostream &out);
+    void flush() { bp.flushAll(); }
+    // Durability point: write back the pool, then fsync/msync the store.
+    // With a write-ahead log every operation is already durable when it
+    // returns; this checkpoints and empties the log.
+    void sync() {
+        if (bp.logging()) {
+            bp.checkpoint();
+            return;
+        }
+        bp.flushAll();
+        bp.syncStore();
+    }
+
+private:
+    // Page-filling orders that get a compile-time layout for lookups
+    static constexpr int FIXED_4K = Layout::orderForPage(4096);
+    static constexpr int FIXED_16K = Layout::orderForPage(16384);
+    static constexpr bool FILTERABLE = is_integral_v<K> && is_same_v<Compare, less<K>>;
+
+    unique_ptr<NodeStore> store;
+    int m;
+    unique_ptr<WriteAheadLog> wal;
+    BufferPool bp;
+    unique_ptr<LatchTable> latchTable;   // only for concurrent handles
+    unique_ptr<ShadowMap> shadow;        // only for copy-on-write handles
+    unique_ptr<BloomFilter> bloom;       // only for files with a filter
+    Compare cmp;
+
+    // Split policy. lastInsert[node % INSERT_HINTS] holds node << 32 | the
+    // position of the last entry added to it, while no other node has
+    // taken the slot since. spine is the path to the rightmost leaf as of
+    // bp.shape() == spineShape; appends past its last key start there
+    // instead of descending. Only handles that neither latch nor copy nodes
+    // keep one.
+    static constexpr int INSERT_HINTS = 64;
+    SplitPolicy splitPolicy = SplitPolicy::Even;
+    array<atomic<long long>, INSERT_HINTS> lastInsert{};
+    vector<int> spine;
+    unsigned long long spineShape = 0;
+
+    // Deferred deletes
+    bool deferred = false;
+    mutex pendingLock;
+    condition_variable pendingReady;
+    vector<K> pending;                   // keys whose tombstones are not purged yet
+    bool stopping = false;
+    thread maintainer;                   // only for concurrent handles
+
+    friend class BasicRangeScan<K, V, Compare>;
+    friend class BasicSnapshot<K, V, Compare>;
+    template<class, class, class> friend class BasicAsyncIndex;
+    template<class, class, class> friend bool CompactIndexFile(char*, double, NodeOrder);
+
+    // One writer operation. On a copy-on-write handle writers take turns,
+    // and everything the operation changed becomes visible when it ends.
+    class WriteScope {
+    public:
+        explicit WriteScope(BasicBTreeIndex &t) : t(t) {
+            if (!t.shadow) return;
+            t.shadow->lockWriter();
+            t.bp.beginOp();
+            reclaimRetired(t.bp);
+            t.shadow->startOp();
+        }
+        ~WriteScope() {
+            if (!t.shadow) return;
+            int root = publishShadow<K, V>(t.bp, t.m);
+            t.bp.endOp();
+            t.shadow->publish(root);
+        }
+
+    private:
+        BasicBTreeIndex &t;
+    };
+
+    // Copy-on-write writers take turns instead of latching nodes.
+    LatchTable* writerLatches() { return shadow ? nullptr : latchTable.get(); }
+
+    // Filter upkeep: writers count a key in before the leaf that holds it
+    // is released, and out once it is gone from the leaf.
+    void openFilter(const string &path);
+    bool mayHold(const K &key) {
+        if (!bloom || bloom->mayContain(filterHash(key))) return true;
+        stats().bump(Counter::FilterRejects);
+        return false;
+    }
+    void filterAdd(const K &key) { if (bloom) bloom->add(filterHash(key)); }
+    void filterRemove(const K &key) { if (bloom) bloom->remove(filterHash(key)); }
+    static unsigned long long filterHash(const K &key) {
+        if constexpr (FILTERABLE) return bloomHash((unsigned long long)key);
+        else return 0;
+    }
+
+    // Whether an entry landing at position at of n (itself included) in
+    // node idx carries on a run: 1 ascending (just after the last entry
+    // added there, or past the end of the right spine), -1 descending
+    // (just before it), 0 if not or under SplitPolicy::Even.
+    int runAt(int idx, int at, int n, bool rightEdge) {
+        if (splitPolicy == SplitPolicy::Even) return 0;
+        if (rightEdge && at == n - 1) return 1;
+        if (splitPolicy != SplitPolicy::Sequential) return 0;
+        long long last = lastInsert[idx % INSERT_HINTS].load(memory_order_relaxed);
+        if (last >> 32 != idx) return 0;
+        int lastAt = (int)(unsigned)last;
+        return at == lastAt + 1 ? 1 : at == lastAt ? -1 : 0;
+    }
+    void noteInsert(int node, int at) {
+        lastInsert[node % INSERT_HINTS].store((long long)node << 32 | (unsigned)at, memory_order_relaxed);
+    }
+
+    int insertOne(const K &RecID, const V &Ref);
+    bool eraseOne(const K &RecordID);
+    int buryKeys(vector<K> ids);
+    int removeKeys(vector<K> ids, bool tombstonesOnly);
+    void maintenanceLoop();
+    int descend(const K &key, bool after, vector<int> &path, optional<K> &hi, LatchSet &latches, int root = 1);
+    int readLeaf(const K &key, bool after, NodeType &leaf, optional<K> &hi, int root);
+    const char* acquire(int nodeIndex);
+    void release(int nodeIndex);
+    unsigned long long readVersion(int nodeIndex);
+    bool validate(int nodeIndex, unsigned long long version);
+    V searchFrom(int root, const K &RecordID);
+    template<int M> bool searchFixed(const K &RecordID, V &ref, int root);
+    bool searchView(const K &RecordID, V &ref, int root);
+};
+
+using BTreeIndex = BasicBTreeIndex<int, int>;
+using RangeScan = BasicRangeScan<int, int>;
+using Snapshot = BasicSnapshot<int, int>;
+// 64-bit record IDs and refs (file offsets past 2 GiB)
+using BTreeIndex64 = BasicBTreeIndex<long long, long long>;
+
+// Completion-based front end on one handle, so a single thread can keep a
+// deep queue of index operations. search() and insert() start an operation
+// and return at once; its callback runs from a later poll(), or right away
+// if every node it needs is already cached. An operation walks the tree
+// through the buffer pool. Where a node is not resident, the operation
+// parks and the node's read goes to the I/O engine; operations waiting on
+// the same node share that read. Once an insert has its path in the pool
+// it is applied by the regular insert(). Operations in flight are not
+// ordered with each other: wait for a completion before issuing an
+// operation that depends on it. Over a mapped store, or on a handle shared
+// between threads, operations complete inline.
+template<class K, class V, class Compare = less<K>>
+class BasicAsyncIndex {
+public:
+    explicit BasicAsyncIndex(BasicBTreeIndex<K, V, Compare> &idx, int queueDepth = DEFAULT_QUEUE_DEPTH,
+                             IoBackend backend = IoBackend::Auto)
+        : idx(idx), depth(max(queueDepth, 1)), io(makeIoEngine(backend, max(queueDepth, 1))) {}
+
+    ~BasicAsyncIndex() { drain(); }
+
+    BasicAsyncIndex(const BasicAsyncIndex&) = delete;
+    BasicAsyncIndex& operator=(const BasicAsyncIndex&) = delete;
+
+    // 'done' gets the ref, or NOT_FOUND if the key is not in the index.
+    void search(const K &RecordID, function<void(V)> done) { start({RecordID, V(), false, std::move(done), 1}); }
+    // 'done' gets what insert() returns.
+    void insert(const K &RecID, const V &Ref, function<void(V)> done) { start({RecID, Ref, true, std::move(done), 1}); }
+
+    // Submit waiting reads, then resume the operations whose reads have
+    // completed. With 'wait', blocks until at least one read completes.
+    // Returns the number of operations still in flight.
+    int poll(bool wait = false);
+    void drain() { while (poll(true) > 0) {} }
+
+    // Write every dirty frame back, all the writes in flight at once.
+    void flush() { idx.bp.flushAll(*io); }
+
+    const char* backend() const { return io->name(); }
+
+private:
+    struct Op {
+        K key;
+        V ref;
+        bool isInsert;
+        function<void(V)> done;
+        int node;   // next node to visit
+        unsigned long long reshapes = 0;   // structure generation when it left the root
+    };
+
+    struct Read {
+        vector<char> image;
+        vector<Op> waiting;
+        unsigned long long writesAtSubmit = 0;
+    };
+
+    BasicBTreeIndex<K, V, Compare> &idx;
+    int depth;                        // most reads in flight at once
+    unique_ptr<IoEngine> io;
+    unordered_map<int, Read> reads;   // node -> its read and the operations parked on it
+    deque<int> unsubmitted;           // nodes with parked operations and no read issued yet
+    int inFlight = 0;
+    int parked = 0;
+
+    void start(Op op);
+    void park(Op op);
+    // The index's structure generation (BufferPool::shape(), which unlike
+    // the stats is never reset). Inserts run while other operations are
+    // parked and can move the key a search is heading for to another node,
+    // so a search that saw it change starts over from the root.
+    unsigned long long reshapes() { return idx.bp.shape(); }
+};
+
+using AsyncIndex = BasicAsyncIndex<int, int>;
+
+// Instantiations compiled into the library (btree.cpp). For other key,
+// ref or comparator types include btree_impl.h, which has the template
+// definitions, and instantiate them in one translation unit.
+#define BTREE_INSTANTIATE(prefix, K, V) \
+    prefix class BasicBTreeIndex<K, V>; \
+    prefix class BasicRangeScan<K, V>; \
+    prefix class BasicSnapshot<K, V>; \
+    prefix class BasicAsyncIndex<K, V>; \
+    prefix int getM<K, V>(NodeStore &); \
+    prefix FileHeader makeHeader<K, V>(int, int, int, int, NodeFormat); \
+    prefix void CreateIndexFileFile<K, V>(char*, int, int, int, NodeFormat); \
+    prefix bool BulkLoadIndexFile<K, V>(char*, int, int, vector<pair<K, V>>, double, int, NodeFormat); \
+    prefix bool CompactIndexFile<K, V>(char*, double, NodeOrder); \
+    prefix BasicNode<K, V> readNode<K, V>(BufferPool &, int, int); \
+    prefix void writeAtNode<K, V>(BufferPool &, int, const BasicNode<K, V> &, int);
+
+BTREE_INSTANTIATE(extern template, int, int)
+BTREE_INSTANTIATE(extern template, long long, long long)
+
+void DisplayIndexFileContent(char* filename);
+int SearchARecord(char* filename, int RecordID);
+void MultiSearch(char* filename, span<const int> ids, span<int> refsOut);
+void DeleteRecordFromIndex(char* filename, int RecordID);
+int InsertNewRecordAtIndex(char* filename, int RecID, int Ref);
+int InsertBatch(char* filename, vector<pair<int, int>> records);
+int DeleteBatch(char* filename, vector<int> ids);
+// Counters and latencies of every index handle closed so far
+void DisplayIndexStats();
@@ -0,0 +1,1765 @@
+// btree_impl.h
+// Template definitions of the index engine: node coding, the insert,
+// delete and lookup paths, bulk loading and the handles. btree.cpp
+// instantiates the types listed by BTREE_INSTANTIATE in btree.h; include
+// this header to instantiate the index for other key, ref or comparator
+// types.
+
+#pragma once
+
+#include "btree.h"
+
+// ---------------- NODE CODING ----------------
+
+template<class K, class V>
+BasicNode<K, V> decodeNode(const char *image, int m) {
+    using L = NodeLayout<K, V>;
+    BasicNode<K, V> n(m);
+    const NodeHead &head = headIn(image);
+    n.flag = head.flag();
+    n.count = min(head.count(), m);
+    n.next = head.next;
+    memcpy(n.key.data(), image + L::keysAt(), n.count * sizeof(K));
+    memcpy(n.ref.data(), image + L::refsAt(m), n.count * sizeof(V));
+    return n;
+}
+
+// Unused slots are zeroed, so a node always encodes to the same bytes.
+template<class K, class V>
+void encodeNode(const BasicNode<K, V> &n, char *image, int m) {
+    using L = NodeLayout<K, V>;
+    NodeHead &head = headIn(image);
+    head.set(n.flag, n.count);
+    head.next = n.next;
+    char *keys = image + L::keysAt();
+    char *refs = image + L::refsAt(m);
+    memcpy(keys, n.key.data(), n.count * sizeof(K));
+    memset(keys + n.count * sizeof(K), 0, (m - n.count) * sizeof(K));
+    memcpy(refs, n.ref.data(), n.count * sizeof(V));
+    memset(refs + n.count * sizeof(V), 0, (m - n.count) * sizeof(V));
+}
+
+// Read 'm' from the file header and tell the store the slot and image
+// sizes. Returns 0 if the file has no valid header for these types.
+template<class K, class V>
+int getM(NodeStore &store) {
+    FileHeader h;
+    if (!store.isOpen() || !store.readHeader(h)) return 0;
+    if (h.magic != HEADER_MAGIC || h.version != HEADER_VERSION) return 0;
+    if (h.keyBytes != (int)sizeof(K) || h.refBytes != (int)sizeof(V)) return 0;
+    NodeFormat format = (NodeFormat)h.format;
+    if (h.m < MIN_ORDER) return 0;
+    if (format == NodeFormat::Plain && h.nodeBytes < imageBytes<K, V>(h.m)) return 0;
+    if (format == NodeFormat::Packed && (!PACKABLE<K, V> || h.nodeBytes < packedSlotBytes(h.m, 0))) return 0;
+    if (format != NodeFormat::Plain && format != NodeFormat::Packed) return 0;
+    store.setStride(h.nodeBytes);
+    store.setFormat(format);
+    store.setImage(imageBytes<K, V>(h.m), h.m);
+    return h.m;
+}
+
+// ---------------- HELPERS ----------------
+
+// Entries stay in key order through every change, so none of these sort
+// or allocate: each moves one block of entries (memmove for plain keys
+// and refs).
+
+// Add an entry past the last one.
+template<class K, class V>
+void appendEntry(BasicNode<K, V> &n, const K &key, const V &ref) {
+    n.key[n.count] = key;
+    n.ref[n.count] = ref;
+    n.count++;
+}
+
+// Add an entry at position i, shifting the ones from i on to the right.
+template<class K, class V>
+void insertEntryAt(BasicNode<K, V> &n, int i, const K &key, const V &ref) {
+    move_backward(n.key.begin() + i, n.key.begin() + n.count, n.key.begin() + n.count + 1);
+    move_backward(n.ref.begin() + i, n.ref.begin() + n.count, n.ref.begin() + n.count + 1);
+    n.key[i] = key;
+    n.ref[i] = ref;
+    n.count++;
+}
+
+// Drop entry i, shifting the ones after it to the left.
+template<class K, class V>
+void removeEntryAt(BasicNode<K, V> &n, int i) {
+    move(n.key.begin() + i + 1, n.key.begin() + n.count, n.key.begin() + i);
+    move(n.ref.begin() + i + 1, n.ref.begin() + n.count, n.ref.begin() + i);
+    n.count--;
+}
+
+// Move entries [first, count) of from to the end of to, whose keys are all
+// ordered before them.
+template<class K, class V>
+void moveEntries(BasicNode<K, V> &from, int first, BasicNode<K, V> &to) {
+    move(from.key.begin() + first, from.key.begin() + from.count, to.key.begin() + to.count);
+    move(from.ref.begin() + first, from.ref.begin() + from.count, to.ref.begin() + to.count);
+    to.count += from.count - first;
+    from.count = first;
+}
+
+// Split a node with (key, ref) going in at position at: n keeps the first
+// mid of the count + 1 entries and the empty node right takes the rest.
+template<class K, class V>
+void splitInsertAt(BasicNode<K, V> &n, BasicNode<K, V> &right, int mid, int at, const K &key, const V &ref) {
+    if (at < mid) {
+        moveEntries(n, mid - 1, right);
+        insertEntryAt(n, at, key, ref);
+    } else {
+        moveEntries(n, mid, right);
+        insertEntryAt(right, at - mid, key, ref);
+    }
+}
+
+// (key, ref) pairs by key, then by ref.
+template<class K, class V, class Compare>
+auto pairOrder(Compare cmp) {
+    return [cmp](const pair<K, V> &a, const pair<K, V> &b) {
+        return cmp(a.first, b.first) || (!cmp(b.first, a.first) && a.second < b.second);
+    };
+}
+
+template<class K, class V>
+void writeNodeToDisk(fstream &f, int nodeIndex, const BasicNode<K, V> &n, int m, long long stride, NodeFormat format) {
+    vector<char> image(imageBytes<K, V>(m));
+    encodeNode(n, image.data(), m);
+    if (!PACKABLE<K, V> || format == NodeFormat::Plain) {
+        writeNodeImage(f, nodeIndex, image.data(), image.size(), stride);
+        return;
+    }
+    vector<char> slot(stride);
+    packImage(image.data(), m, slot.data(), stride);
+    f.seekp((long long)nodeIndex * stride, ios::beg);
+    f.write(slot.data(), stride);
+}
+
+// ---------------- NODE I/O ----------------
+
+// A copy-on-write writer also notes where it found each child, for
+// publishShadow().
+template<class K, class V>
+BasicNode<K, V> readNode(BufferPool &bp, int nodeIndex, int m) {
+    int slot = shadowSlot(bp, nodeIndex);
+    BasicNode<K, V> n = decodeNode<K, V>(bp.pin(slot), m);
+    bp.unpin(slot, false);
+    if (ShadowMap *map = bp.shadow(); map && n.flag == 1 && map->writing())
+        for (int i = 0; i < n.count; i++) map->setParent((int)n.ref[i], nodeIndex);
+    return n;
+}
+
+template<class K, class V>
+void writeAtNode(BufferPool &bp, int nodeIndex, const BasicNode<K, V> &n, int m) {
+    int slot = bp.shadow() ? shadowWritable(bp, nodeIndex) : nodeIndex;
+    encodeNode(n, bp.pinForWrite(slot), m);
+    bp.unpin(slot, true);
+}
+
+template<class K, class V, class Compare>
+void updateParentMax(BufferPool &bp, int parentIndx, int childIndx, const K &newMax, int m, Compare cmp) {
+    if (parentIndx == -1) return;
+    BasicNode<K, V> p = readNode<K, V>(bp, parentIndx, m);
+    bool changed = false;
+    for (int i = 0; i < p.count; i++) {
+        if (p.ref[i] == childIndx) {
+            if (!keyEq(p.key[i], newMax, cmp)) {
+                p.key[i] = newMax;
+                changed = true;
+            }
+            break;
+        }
+    }
+    if (changed) {
+        writeAtNode(bp, parentIndx, p, m);
+        bp.stats().bump(Counter::MaxKeySteps);
+    }
+}
+
+// Walk up 'ancestors' (root first, parent of childIdx last) refreshing each
+// parent's key for the child below it; stops at the first unchanged level.
+// An empty child keeps its old key, which still bounds it.
+template<class K, class V, class Compare>
+void propagateMaxUp(BufferPool &bp, const vector<int> &ancestors, int childIdx, int m, Compare cmp) {
+    int child = childIdx;
+    for (int i = (int)ancestors.size() - 1; i >= 0; i--) {
+        int parent = ancestors[i];
+        BasicNode<K, V> p = readNode<K, V>(bp, parent, m);
+        BasicNode<K, V> c = readNode<K, V>(bp, child, m);
+        if (c.count == 0) break;
+        K cMax = getMaxKey(c);
+        bool updated = false;
+        for (int k = 0; k < p.count; k++) {
+            if (p.ref[k] == child && !keyEq(p.key[k], cMax, cmp)) {
+                p.key[k] = cMax;
+                updated = true;
+            }
+        }
+        if (!updated) break;
+        writeAtNode(bp, parent, p, m);
+        bp.stats().bump(Counter::MaxKeySteps);
+        child = parent;
+    }
+}
+
+// ---------------- SHADOW PAGING ----------------
+
+// End of a copy-on-write operation. Parents the operation did not write
+// are copied too, up to the root, then every internal node it wrote is
+// pointed at the copies of its children. Returns the slot of the new root,
+// already recorded in the header.
+template<class K, class V>
+int publishShadow(BufferPool &bp, int m) {
+    ShadowMap &map = *bp.shadow();
+    vector<int> work;
+    for (auto &[node, slot] : map.movedNodes()) work.push_back(node);
+    while (!work.empty()) {
+        int node = work.back();
+        work.pop_back();
+        int parent = map.parentOf(node);
+        if (parent == -1 || map.isFresh(map.slotOf(parent)) || map.wasFreed(parent)) continue;
+        writeAtNode(bp, parent, readNode<K, V>(bp, parent, m), m);
+        work.push_back(parent);
+    }
+
+    for (int slot : map.freshSlots()) {
+        BasicNode<K, V> n = decodeNode<K, V>(bp.pin(slot), m);
+        bp.unpin(slot, false);
+        if (n.flag != 1) continue;
+        bool changed = false;
+        for (int i = 0; i < n.count; i++) {
+            int child = map.slotOf((int)n.ref[i]);
+            if (child != n.ref[i]) {
+                n.ref[i] = child;
+                changed = true;
+            }
+        }
+        if (!changed) continue;
+        encodeNode(n, bp.pinForWrite(slot), m);
+        bp.unpin(slot, true);
+    }
+
+    int root = map.slotOf(1);
+    FileHeader &head = headerIn(bp.pin(0));
+    bool moved = head.root != root;
+    bp.unpin(0, false);
+    if (moved) {
+        headerIn(bp.pinForWrite(0)).root = root;
+        bp.unpin(0, true);
+    }
+    return root;
+}
+
+// The old root slot is not on the free list, so it is freed here; Node 1
+// was kept out of use while the root was elsewhere. Copies never relink
+// the leaf chain, so it is rebuilt from the tree in the same operation.
+template<class K, class V>
+void homeRoot(BufferPool &bp, int m) {
+    int root = headerIn(bp.pin(0)).root;
+    bp.unpin(0, false);
+    if (root == 1) return;
+    OpScope op(bp);
+    memcpy(bp.pinForWrite(1), bp.pin(root), bp.imageSize());
+    bp.unpin(root, false);
+    bp.unpin(1, true);
+    headerIn(bp.pinForWrite(0)).root = 1;
+    bp.unpin(0, true);
+    LatchSet none(nullptr, true);
+    freeNode(bp, root, none);
+
+    auto link = [&](int leaf, int next) {
+        int old = headIn(bp.pin(leaf)).next;
+        bp.unpin(leaf, false);
+        if (old == next) return;
+        headIn(bp.pinForWrite(leaf)).next = next;
+        bp.unpin(leaf, true);
+    };
+    // Depth first with children pushed right to left: leaves come off in key order.
+    vector<int> stack = {1};
+    int prev = -1;
+    while (!stack.empty()) {
+        int idx = stack.back();
+        stack.pop_back();
+        BasicNode<K, V> n = readNode<K, V>(bp, idx, m);
+        if (n.flag == 1) {
+            for (int i = n.count - 1; i >= 0; i--) stack.push_back((int)n.ref[i]);
+            continue;
+        }
+        if (n.flag != 0) continue;
+        if (prev != -1) link(prev, idx);
+        prev = idx;
+    }
+    if (prev != -1) link(prev, -1);
+}
+
+// ---------------- UNDERFLOW ----------------
+
+// Siblings are latched before they are read: another writer may have
+// stopped its crabbing there and still be working in it. Nodes a merge
+// empties go into 'freed' instead of the free list, see solveUnderflow.
+template<class K, class V, class Compare>
+void mergeUp(BufferPool &bp, int currentIdx, vector<int>& path, int m, LatchSet &latches, Compare cmp,
+             vector<int> &freed) {
+    BasicNode<K, V> curr = readNode<K, V>(bp, currentIdx, m);
+    int minKeys = m / 2; // e.g., 5/2 = 2
+
+    // If we reached the root (Node 1)
+    if (currentIdx == 1) {
+        // If root is internal and has only 1 child, that child becomes the new root content
+        if (curr.flag == 1 && countKeys(curr) == 1) {
+            int childIdx = (int)curr.ref[0];
+            latches.lock(childIdx);
+            BasicNode<K, V> child = readNode<K, V>(bp, childIdx, m);
+
+            // Move child content to Node 1
+            writeAtNode(bp, 1, child, m);
+
+            // Free the old child node
+            freed.push_back(childIdx);
+            bp.reshaped();
+        }
+        // If root is leaf, it can have 0 keys (empty file), no underflow fix needed
+        return;
+    }
+    // If node has enough keys, stop
+    if (countKeys(curr) >= minKeys) return;
+    // 2. GET PARENT & SIBLINGS
+    int parentIdx = path.back();
+    BasicNode<K, V> parent = readNode<K, V>(bp, parentIdx, m);
+    // Find our position in parent
+    int ptrIndex = -1;
+    for (int i = 0; i < parent.count; i++) {
+        if (parent.ref[i] == currentIdx) { ptrIndex = i; break; }
+    }
+
+    int leftSiblingIdx = -1;
+    int rightSiblingIdx = -1;
+    if (ptrIndex > 0) leftSiblingIdx = (int)parent.ref[ptrIndex - 1];
+    if (ptrIndex != -1 && ptrIndex + 1 < parent.count) rightSiblingIdx = (int)parent.ref[ptrIndex + 1];
+
+    // 3. TRY BORROW FROM LEFT
+    if (leftSiblingIdx != -1) {
+        latches.lock(leftSiblingIdx);
+        BasicNode<K, V> left = readNode<K, V>(bp, leftSiblingIdx, m);
+        if (countKeys(left) > minKeys) {
+            // Take largest from left (its last item)
+            int lastPos = left.count - 1;
+            K maxK = left.key[lastPos];
+            V maxR = left.ref[lastPos];
+
+            // Remove from Left
+            removeEntryAt(left, lastPos);
+            // Add to Curr (it goes first)
+            insertEntryAt(curr, 0, maxK, maxR);
+
+            // Update Disk
+            writeAtNode(bp, leftSiblingIdx, left, m);
+            writeAtNode(bp, currentIdx, curr, m);
+
+            // Update Parent Keys (Left Max changed, Curr Max might change)
+            updateParentMax<K, V>(bp, parentIdx, leftSiblingIdx, getMaxKey(left), m, cmp);
+            updateParentMax<K, V>(bp, parentIdx, currentIdx, getMaxKey(curr), m, cmp);
+            bp.stats().bump(Counter::BorrowsLeft);
+            bp.reshaped();
+            return;
+        }
+    }
+
+    // 4. TRY BORROW FROM RIGHT
+    if (rightSiblingIdx != -1) {
+        latches.lock(rightSiblingIdx);
+        BasicNode<K, V> right = readNode<K, V>(bp, rightSiblingIdx, m);
+        if (countKeys(right) > minKeys) {
+            // Take smallest from right
+            K minK = right.key[0];
+            V minR = right.ref[0];
+
+            // Remove from Right (Shift remaining)
+            removeEntryAt(right, 0);
+
+            // Add to Curr (it goes last)
+            appendEntry(curr, minK, minR);
+
+            // Update Disk
+            writeAtNode(bp, rightSiblingIdx, right, m);
+            writeAtNode(bp, currentIdx, curr, m);
+
+            // Update Parent Keys
+            updateParentMax<K, V>(bp, parentIdx, rightSiblingIdx, getMaxKey(right), m, cmp);
+            updateParentMax<K, V>(bp, parentIdx, currentIdx, getMaxKey(curr), m, cmp);
+            bp.stats().bump(Counter::BorrowsRight);
+            bp.reshaped();
+            return;
+        }
+    }
+
+    // 5. MERGE WITH LEFT (if borrow failed)
+    // Neither sibling could lend, so both halves together hold fewer than m.
+    if (leftSiblingIdx != -1) {
+        BasicNode<K, V> left = readNode<K, V>(bp, leftSiblingIdx, m);
+
+        // Move all items from Curr to Left
+        moveEntries(curr, 0, left);
+        if (!bp.fits(left)) return;   // packed: leave curr underfull rather than overflow left
+        left.next = curr.next; // Unlink Curr from the leaf chain
+        writeAtNode(bp, leftSiblingIdx, left, m);
+
+        // Free Curr
+        freed.push_back(currentIdx);
+
+        // Remove Curr from Parent
+        removeEntryAt(parent, ptrIndex);
+        writeAtNode(bp, parentIdx, parent, m);
+
+        // Update Parent Key for Left (it grew)
+        updateParentMax<K, V>(bp, parentIdx, leftSiblingIdx, getMaxKey(left), m, cmp);
+        bp.stats().bump(Counter::Merges);
+        bp.reshaped();
+
+        // RECURSE: Parent might now have too few keys
+        path.pop_back(); // Remove parent from path (we are about to pass path to recursive call)
+        mergeUp<K, V>(bp, parentIdx, path, m, latches, cmp, freed);
+        return;
+    }
+
+    // 6. MERGE WITH RIGHT
+    if (rightSiblingIdx != -1) {
+        BasicNode<K, V> right = readNode<K, V>(bp, rightSiblingIdx, m);
+
+        // Move all items from Right to Curr
+        moveEntries(right, 0, curr);
+        if (!bp.fits(curr)) return;
+        curr.next = right.next; // Unlink Right from the leaf chain
+        writeAtNode(bp, currentIdx, curr, m);
+
+        // Free Right
+        freed.push_back(rightSiblingIdx);
+
+        // Remove Right from Parent
+        int rightPtrPos = -1;
+        for (int i = 0; i < parent.count; i++) if (parent.ref[i] == rightSiblingIdx) rightPtrPos = i;
+
+        if (rightPtrPos != -1) {
+            removeEntryAt(parent, rightPtrPos);
+            writeAtNode(bp, parentIdx, parent, m);
+        }
+
+        // Update Parent Key for Curr (it grew)
+        updateParentMax<K, V>(bp, parentIdx, currentIdx, getMaxKey(curr), m, cmp);
+        bp.stats().bump(Counter::Merges);
+        bp.reshaped();
+
+        path.pop_back();
+        mergeUp<K, V>(bp, parentIdx, path, m, latches, cmp, freed);
+        return;
+    }
+}
+
+// The free list's latch (node 0's) is held until the operation commits, so
+// it has to be the last latch an operation takes: the nodes are freed once
+// every sibling the merges needed has been latched.
+template<class K, class V, class Compare>
+void solveUnderflow(BufferPool &bp, int currentIdx, vector<int>& path, int m, LatchSet &latches, Compare cmp) {
+    vector<int> freed;
+    mergeUp<K, V>(bp, currentIdx, path, m, latches, cmp, freed);
+    for (int idx : freed) freeNode(bp, idx, latches);
+}
+
+// ---------------- FILE CREATION / BULK LOAD ----------------
+
+template<class K, class V>
+FileHeader makeHeader(int m, int pageBytes, int nodeCount, int freeHead, NodeFormat format) {
+    if (!PACKABLE<K, V>) format = NodeFormat::Plain;
+    FileHeader h;
+    h.magic = HEADER_MAGIC;
+    h.version = HEADER_VERSION;
+    h.m = m;
+    h.nodeBytes = (int)(format == NodeFormat::Packed ? packedSlotBytes(m, pageBytes) : slotBytes<K, V>(m, pageBytes));
+    h.format = (int)format;
+    h.keyBytes = sizeof(K);
+    h.refBytes = sizeof(V);
+    h.root = 1;
+    h.nodeCount = nodeCount;
+    h.freeHead = freeHead;
+    return h;
+}
+
+// numOfRecords is the number of slots, header included. With pageBytes > 0
+// (e.g. 4096) every node is padded and aligned to the page size; pick m with
+// NodeLayout<K, V>::orderForPage(pageBytes) for nodes that exactly fill a page.
+template<class K, class V>
+void CreateIndexFileFile(char* filename, int numOfRecords, int m, int pageBytes, NodeFormat format) {
+    FileHeader h = makeHeader<K, V>(m, pageBytes, numOfRecords, (numOfRecords > 1) ? 1 : -1, format);
+    fstream f(filename, ios::out | ios::binary | ios::trunc);
+    writeHeaderToDisk(f, h);
+    for (int i = 1; i < numOfRecords; i++) {
+        BasicNode<K, V> n(m);
+        n.next = (i < numOfRecords - 1) ? i + 1 : -1;
+        writeNodeToDisk(f, i, n, m, h.nodeBytes, (NodeFormat)h.format);
+    }
+    f.close();
+    filesystem::resize_file(filename, (long long)numOfRecords * h.nodeBytes);
+    error_code ec;
+    filesystem::remove(string(filename) + ".bloom", ec);   // a filter of the old contents
+}
+
+// Write a tree of records (sorted, keys unique) to a new file with header
+// h: leaves at the given fill factor, chained left to right, and each
+// internal level above them (parent key = child max) up to the root in
+// Node 1, all placed in the given order. numOfRecords is a minimum slot
+// count: the file is made larger if the tree needs more, and any remaining
+// nodes go to the free list. Returns false if the file cannot be written.
+template<class K, class V>
+bool writeTree(const char* filename, FileHeader h, const vector<pair<K, V>> &records, double fillFactor,
+               int numOfRecords, NodeOrder order) {
+    int m = h.m;
+    long long stride = h.nodeBytes;
+    NodeFormat format = (NodeFormat)h.format;
+    int minKeys = max(m / 2, 1);
+    int perNode = min(m, max(minKeys, (int)(fillFactor * m + 0.5)));
+
+    // The shape is settled before the slots, but whether a packed node fits
+    // its slot depends on the child slots it holds. A level with a node
+    // that does not fit is regrouped smaller, and a root that does not fit
+    // gets a level under it; then the tree is placed again.
+    vector<int> target;
+    int minLevels = 1;
+    vector<vector<int>> sizes, start, slot;
+    vector<vector<K>> maxKey;
+    auto nodeAt = [&](int l, int g) {
+        BasicNode<K, V> n(m);
+        n.flag = l > 0;
+        for (int i = start[l][g]; i < start[l][g + 1]; i++) {
+            if (l == 0) appendEntry(n, records[i].first, records[i].second);
+            else appendEntry(n, maxKey[l - 1][i], (V)slot[l - 1][i]);
+        }
+        if (l == 0 && g + 1 < (int)sizes[0].size()) n.next = slot[0][g + 1];
+        return n;
+    };
+    for (;;) {
+        sizes.clear();
+        int count = (int)records.size();
+        for (int l = 0; count > m || l + 1 < minLevels; l++) {
+            if ((int)target.size() == l) target.push_back(perNode);
+            sizes.push_back(groupSizes(count, target[l], max(minKeys, 2)));
+            count = (int)sizes.back().size();
+        }
+        sizes.push_back({count});
+        int levels = (int)sizes.size();
+        start.assign(levels, {0});
+        maxKey.assign(levels, {});
+        for (int l = 0; l < levels; l++)
+            for (int size : sizes[l]) {
+                int end = start[l].back() + size;
+                start[l].push_back(end);
+                if (size > 0) maxKey[l].push_back(l == 0 ? records[end - 1].first : maxKey[l - 1][end - 1]);
+            }
+        slot = placeNodes(sizes, order);
+
+        int misfit = -1;
+        if constexpr (PACKABLE<K, V>) {
+            for (int l = 0; l < levels && misfit == -1 && format == NodeFormat::Packed; l++)
+                for (int g = 0; g < (int)sizes[l].size(); g++)
+                    if (packedBytes(nodeAt(l, g)) > stride) {
+                        misfit = l;
+                        break;
+                    }
+        }
+        if (misfit == -1) break;
+        if (misfit == levels - 1) minLevels = levels + 1;
+        else if (target[misfit] > minKeys) target[misfit] = max(minKeys, target[misfit] * 7 / 8);
+        else break;   // cannot happen: half a node always fits
+    }
+
+    int used = 0;
+    for (auto &level : sizes) used += (int)level.size();
+    int nodeCount = max(numOfRecords, used + 1);
+    vector<pair<int, int>> at(used + 1);   // slot -> (level, node)
+    for (int l = 0; l < (int)sizes.size(); l++)
+        for (int g = 0; g < (int)sizes[l].size(); g++) at[slot[l][g]] = {l, g};
+
+    fstream f(filename, ios::out | ios::binary | ios::trunc);
+    if (!f.is_open()) return false;
+    h.root = 1;
+    h.nodeCount = nodeCount;
+    h.freeHead = (used + 1 < nodeCount) ? used + 1 : -1;
+    writeHeaderToDisk(f, h);
+    for (int s = 1; s <= used; s++) writeNodeToDisk(f, s, nodeAt(at[s].first, at[s].second), m, stride, format);
+    for (int i = used + 1; i < nodeCount; i++) {
+        BasicNode<K, V> n(m);
+        n.next = (i < nodeCount - 1) ? i + 1 : -1;
+        writeNodeToDisk(f, i, n, m, stride, format);
+    }
+    f.close();
+    if (f.fail()) return false;
+    error_code ec;
+    filesystem::resize_file(filename, (long long)nodeCount * stride, ec);
+    return !ec;
+}
+
+// Build an index bottom-up from (RecordID, Ref) pairs instead of inserting
+// them one by one. Leaves are written sequentially from Node 2 at the given
+// fill factor and chained left to right, then each internal level above them
+// (parent key = child max), and the top level becomes the root in Node 1.
+// numOfRecords is a minimum slot count: the file is made larger if the tree
+// needs more, and any remaining nodes go to the free list. Records whose
+// ref is NOT_FOUND are skipped, as insertBatch does: the leaf entry would
+// be a tombstone. Returns false if the file cannot be written.
+template<class K, class V, class Compare>
+bool BulkLoadIndexFile(char* filename, int numOfRecords, int m,
+                       vector<pair<K, V>> records, double fillFactor, int pageBytes, NodeFormat format) {
+    Compare cmp;
+    auto order = pairOrder<K, V>(cmp);
+    erase_if(records, [](const pair<K, V> &r) { return r.second == BasicBTreeIndex<K, V, Compare>::NOT_FOUND; });
+    if (!is_sorted(records.begin(), records.end(), order)) sort(records.begin(), records.end(), order);
+    records.erase(unique(records.begin(), records.end(),
+                         [&](const pair<K, V> &a, const pair<K, V> &b) { return keyEq(a.first, b.first, cmp); }),
+                  records.end());
+    if (records.empty()) {
+        CreateIndexFileFile<K, V>(filename, numOfRecords, m, pageBytes, format);
+        return true;
+    }
+    FileHeader h = makeHeader<K, V>(m, pageBytes, numOfRecords, -1, format);
+    if (!writeTree(filename, h, records, fillFactor, numOfRecords, NodeOrder::LeavesFirst)) return false;
+    error_code ec;
+    filesystem::remove(string(filename) + ".bloom", ec);
+    return true;
+}
+
+// Rewrite an index into a fresh file, then rename it over the old one:
+// live records only, leaves at the given fill in key order, nodes in the
+// given order and no free slots. Churn scatters a tree over its file
+// through the free list and leaves nodes half full; the rewrite puts
+// neighbouring leaves next to each other for scans and fewer nodes on
+// each path. The copy is made durable before the rename, so a crash
+// leaves either file whole. A write-ahead log is applied first and the
+// Bloom filter is kept, since the keys do not change. Returns false, with
+// the file as it was, if it cannot be opened or the copy not written.
+template<class K, class V, class Compare>
+bool CompactIndexFile(char* filename, double fillFactor, NodeOrder order) {
+    string path = filename, copy = path + ".compact";
+    FileHeader h;
+    vector<pair<K, V>> records;
+    {
+        IndexOptions opts;
+        opts.writeAheadLog = filesystem::exists(path + ".wal");
+        BasicBTreeIndex<K, V, Compare> idx(filename, opts);
+        if (!idx.isOpen()) return false;
+        h = headerIn(idx.bp.pin(0));
+        idx.bp.unpin(0, false);
+        // Down the leftmost path to the first leaf, then along the chain
+        BasicNode<K, V> n = readNode<K, V>(idx.bp, h.root, idx.m);
+        while (n.flag == 1) n = readNode<K, V>(idx.bp, (int)n.ref[0], idx.m);
+        for (;;) {
+            for (int i = 0; i < n.count; i++)
+                if (n.ref[i] != BasicBTreeIndex<K, V, Compare>::NOT_FOUND) records.push_back({n.key[i], n.ref[i]});
+            if (n.next == -1) break;
+            n = readNode<K, V>(idx.bp, n.next, idx.m);
+        }
+    }
+
+    error_code ec;
+    if (!writeTree(copy.c_str(), h, records, fillFactor, 0, order)) {
+        filesystem::remove(copy, ec);
+        return false;
+    }
+    int fd = open(copy.c_str(), O_RDONLY);
+    bool durable = fd >= 0 && fsync(fd) == 0;
+    if (fd >= 0) close(fd);
+    if (!durable || rename(copy.c_str(), filename) != 0) {
+        filesystem::remove(copy, ec);
+        return false;
+    }
+    // and the rename itself
+    string dir = filesystem::path(path).parent_path().string();
+    fd = open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+    return true;
+}
+
+//--------------------- OPRATIONS ----------------------
+
+template<class K, class V, class Compare>
+BasicBTreeIndex<K, V, Compare>::BasicBTreeIndex(const char* filename, IndexOptions opts)
+    : store(openStore(filename, opts.storage)), m(getM<K, V>(*store)), bp(*store, store->imageSize()) {
+    if (!isOpen()) return;
+    if (opts.concurrent) {
+        latchTable = make_unique<LatchTable>();
+        bp.setThreadSafe(true);
+    }
+    if (opts.writeAheadLog) {
+        wal = make_unique<WriteAheadLog>(string(filename) + ".wal");
+        if (wal->isOpen()) {
+            wal->recover(*store, store->imageSize());
+            bp.attachLog(wal.get());
+        }
+    }
+    // Packed nodes are not copied: pointing a parent at the copies can
+    // take it past its slot, so packed files are always written in place.
+    if (opts.copyOnWrite && store->nodeFormat() == NodeFormat::Plain) {
+        shadow = make_unique<ShadowMap>(headerIn(bp.pin(0)).root);
+        bp.unpin(0, false);
+        bp.attachShadow(shadow.get());
+    } else {
+        homeRoot<K, V>(bp, m);
+    }
+    bp.pin(0);
+    bp.pin(1);
+    string filterPath = string(filename) + ".bloom";
+    if (FILTERABLE && (opts.bloomFilter || filesystem::exists(filterPath))) openFilter(filterPath);
+    deferred = opts.deferredDeletes;
+    splitPolicy = opts.split;
+    if (deferred && latchTable) maintainer = thread(&BasicBTreeIndex::maintenanceLoop, this);
+}
+
+// Use the file's filter, rebuilding it from a scan of every key when it
+// cannot be trusted as it is. Without a usable filter the handle goes on
+// without one.
+template<class K, class V, class Compare>
+void BasicBTreeIndex<K, V, Compare>::openFilter(const string &path) {
+    if constexpr (FILTERABLE) {
+        bloom = make_unique<BloomFilter>(path, (int)sizeof(K));
+        if (!bloom->isOpen()) {
+            bloom.reset();
+            return;
+        }
+        if (!bloom->stale()) return;
+        vector<unsigned long long> hashes;
+        BasicRangeScan<K, V, Compare> it = openScan(numeric_limits<K>::lowest(), numeric_limits<K>::max());
+        K key;
+        V ref;
+        while (it.next(key, ref)) hashes.push_back(filterHash(key));
+        if (!bloom->rebuild(hashes)) bloom.reset();
+    }
+}
+
+// Keys without an operator<< (composite structs) print as their bytes in hex.
+template<class K>
+void printKey(ostream &out, const K &key) {
+    if constexpr (requires { out << key; }) {
+        out << key;
+    } else {
+        static const char digits[] = "0123456789abcdef";
+        const unsigned char *b = reinterpret_cast<const unsigned char*>(&key);
+        out << "0x";
+        for (size_t i = 0; i < sizeof(K); i++) out << digits[b[i] >> 4] << digits[b[i] & 15];
+    }
+}
+
+// Empty slots print as [-1,-1] and a free node's link as [-1,next], the
+// way the assignment's file dumps show them.
+template<class K, class V, class Compare>
+void BasicBTreeIndex<K, V, Compare>::display(ostream &out) {
+    FileHeader h = headerIn(bp.pin(0));
+    bp.unpin(0, false);
+    out << "Header: m=" << h.m << " nodeBytes=" << h.nodeBytes << " root=" << h.root
+        << " nodes=" << h.nodeCount << " free=" << h.freeHead << "\n";
+    out << "-------------------------------------------------------";
+    out << "\n";
+
+    for (int i = 1; i < h.nodeCount; i++) {
+        NodeType n = readNode<K, V>(bp, i, m);
+        out << "N " << i << ": {" << n.flag << "}";
+        for(int j=0; j<m; j++) {
+            if (j < n.count) {
+                out << " [";
+                printKey(out, n.key[j]);
+                out << "," << n.ref[j] << "]";
+            }
+            else if (j == 0 && n.flag == -1) out << " [-1," << n.next << "]";
+            else out << " [-1,-1]";
+        }
+        if (n.flag == 0) out << " -> " << n.next;
+        out << "\n";
+        out << "-------------------------------------------------------";
+        out << "\n";
+    }
+}
+
+// Read-only image of a node, valid until release(): straight from the
+// mapping when mapped, otherwise from a pinned pool frame.
+template<class K, class V, class Compare>
+const char* BasicBTreeIndex<K, V, Compare>::acquire(int nodeIndex) {
+    if (store->mapped()) return store->view(nodeIndex);
+    return bp.pin(nodeIndex);
+}
+
+template<class K, class V, class Compare>
+void BasicBTreeIndex<K, V, Compare>::release(int nodeIndex) {
+    if (store->mapped()) return;
+    bp.unpin(nodeIndex, false);
+}
+
+// Optimistic reads on a concurrent handle; a single-threaded handle has
+// nothing to check.
+template<class K, class V, class Compare>
+unsigned long long BasicBTreeIndex<K, V, Compare>::readVersion(int nodeIndex) {
+    return latchTable ? latchTable->stableVersion(nodeIndex) : 0;
+}
+
+template<class K, class V, class Compare>
+bool BasicBTreeIndex<K, V, Compare>::validate(int nodeIndex, unsigned long long version) {
+    return !latchTable || latchTable->unchanged(nodeIndex, version);
+}
+
+// One optimistic root-to-leaf pass. The parent is validated before its
+// child pointer is followed and again once the child's version is known,
+// so the child was really linked when that version was read. Returns
+// false if a writer got in the way and the lookup has to start over.
+template<class K, class V, class Compare>
+template<int M>
+bool BasicBTreeIndex<K, V, Compare>::searchFixed(const K &RecordID, V &ref, int root) {
+    int curIdx = root;
+    unsigned long long version = readVersion(curIdx);
+    const char *p = acquire(curIdx);
+    ref = NOT_FOUND;
+    if (!p) return true;
+
+    while (FixedNode<K, V, M>::at(p).flag() == 1) {
+        const FixedNode<K, V, M> &cur = FixedNode<K, V, M>::at(p);
+        int nextIdx = -1;
+        int count = cur.count();
+        int slot = firstKeyAtLeast(cur.key.data(), count, RecordID, cmp);
+        if (slot == count) slot = count - 1;   // past every key: rightmost child
+        if (slot >= 0) nextIdx = (int)cur.ref[slot];
+        release(curIdx);
+        if (!validate(curIdx, version)) return false;
+        if (nextIdx == -1) return true;
+        unsigned long long nextVersion = readVersion(nextIdx);
+        if (!validate(curIdx, version)) return false;
+        curIdx = nextIdx;
+        version = nextVersion;
+        p = acquire(curIdx);
+        if (!p) return validate(curIdx, version);
+    }
+
+    const FixedNode<K, V, M> &leaf = FixedNode<K, V, M>::at(p);
+    if (leaf.flag() == 0) {
+        int count = leaf.count();
+        int slot = firstKeyAtLeast(leaf.key.data(), count, RecordID, cmp);
+        if (slot < count && !cmp(RecordID, leaf.key[slot])) ref = leaf.ref[slot];
+    }
+    release(curIdx);
+    return validate(curIdx, version);
+}
+
+// searchFixed() for any other m, through the runtime-m view.
+template<class K, class V, class Compare>
+bool BasicBTreeIndex<K, V, Compare>::searchView(const K &RecordID, V &ref, int root) {
+    int curIdx = root;
+    unsigned long long version = readVersion(curIdx);
+    const char *p = acquire(curIdx);
+    ref = NOT_FOUND;
+    if (!p) return true;
+
+    while (NodeView<K, V>{p, m}.flag() == 1) {
+        NodeView<K, V> cur{p, m};
+        int nextIdx = -1;
+        int count = cur.count();
+        int slot = firstKeyAtLeast(cur.keys(), count, RecordID, cmp);
+        if (slot == count) slot = count - 1;
+        if (slot >= 0) nextIdx = (int)cur.ref(slot);
+        release(curIdx);
+        if (!validate(curIdx, version)) return false;
+        if (nextIdx == -1) return true;
+        unsigned long long nextVersion = readVersion(nextIdx);
+        if (!validate(curIdx, version)) return false;
+        curIdx = nextIdx;
+        version = nextVersion;
+        p = acquire(curIdx);
+        if (!p) return validate(curIdx, version);
+    }
+
+    NodeView<K, V> leaf{p, m};
+    if (leaf.flag() == 0) {
+        int count = leaf.count();
+        int slot = firstKeyAtLeast(leaf.keys(), count, RecordID, cmp);
+        if (slot < count && !cmp(RecordID, leaf.key(slot))) ref = leaf.ref(slot);
+    }
+    release(curIdx);
+    return validate(curIdx, version);
+}
+
+// Nodes are read in place (no copy into a Node); page-filling fanouts use
+// the compile-time layout, anything else the runtime-m view. Lookups take
+// no latches: on a concurrent handle they validate node versions instead
+// and retry when a writer changed a node they read. A copy-on-write
+// handle reads the current version, which no writer changes. A key the
+// filter rejects is not looked for at all.
+template<class K, class V, class Compare>
+V BasicBTreeIndex<K, V, Compare>::search(const K &RecordID) {
+    OpTimer timer(stats(), OpKind::Search);
+    if (!mayHold(RecordID)) return NOT_FOUND;
+    SnapshotPin pin(shadow.get());
+    return searchFrom(pin.root, RecordID);
+}
+
+template<class K, class V, class Compare>
+V BasicBTreeIndex<K, V, Compare>::searchFrom(int root, const K &RecordID) {
+    V ref;
+    if (m == 5) { while (!searchFixed<5>(RecordID, ref, root)) {} return ref; }
+    if (m == FIXED_4K) { while (!searchFixed<FIXED_4K>(RecordID, ref, root)) {} return ref; }
+    if (m == FIXED_16K) { while (!searchFixed<FIXED_16K>(RecordID, ref, root)) {} return ref; }
+    while (!searchView(RecordID, ref, root)) {}
+    return ref;
+}
+
+// Bytes of each child node prefetched ahead of its level: the first cache
+// lines only, the hardware prefetcher follows the key scan from there.
+static constexpr int PREFETCH_BYTES = 128;
+
+// Resolve many keys in one pass over the tree, a level at a time. Probes
+// are sorted by key, so the ones routed through the same node are adjacent
+// and share one read of it. Every node of the next level is known before
+// any of them is read: from a mapping they are prefetched as soon as they
+// are found, through the pool they are loaded in file order. refsOut[i]
+// gets the ref of ids[i], or NOT_FOUND. On a concurrent handle a probe
+// whose nodes changed under it is redone on its own with search().
+template<class K, class V, class Compare>
+void BasicBTreeIndex<K, V, Compare>::multiSearch(span<const K> ids, span<V> refsOut) {
+    OpTimer timer(stats(), OpKind::MultiSearch);
+    SnapshotPin pin(shadow.get());
+    size_t n = min(ids.size(), refsOut.size());
+    fill(refsOut.begin(), refsOut.begin() + n, NOT_FOUND);
+    vector<int> order;
+    order.reserve(n);
+    for (size_t i = 0; i < n; i++) if (mayHold(ids[i])) order.push_back((int)i);
+    n = order.size();
+    sort(order.begin(), order.end(), [&](int a, int b) { return cmp(ids[a], ids[b]); });
+
+    // Per probe, in key order: the node it is at and the node (and version)
+    // it came from, -1 once resolved.
+    vector<int> node(n, pin.root), parent(n, -1);
+    vector<unsigned long long> parentVersion(n, 0);
+    vector<int> retry;
+
+    while (true) {
+        vector<pair<size_t, size_t>> groups;
+        for (size_t i = 0; i < n;) {
+            if (node[i] == -1) { i++; continue; }
+            size_t j = i + 1;
+            while (j < n && node[j] == node[i]) j++;
+            groups.push_back({i, j});
+            i = j;
+        }
+        if (groups.empty()) break;
+        sort(groups.begin(), groups.end(), [&](auto &a, auto &b) { return node[a.first] < node[b.first]; });
+
+        for (auto [start, end] : groups) {
+            int idx = node[start];
+            unsigned long long version = readVersion(idx);
+            bool stale = false;
+            for (size_t k = start; k < end; k++) {
+                if (parent[k] != -1 && !validate(parent[k], parentVersion[k])) stale = true;
+            }
+            const char *p = stale ? nullptr : acquire(idx);
+            if (p) {
+                NodeView<K, V> cur{p, m};
+                bool internal = cur.flag() == 1;
+                int count = cur.count();
+                for (size_t k = start; k < end; k++) {
+                    const K &key = ids[order[k]];
+                    node[k] = -1;
+                    int slot = firstKeyAtLeast(cur.keys(), count, key, cmp);
+                    if (internal) {
+                        if (slot == count) slot = count - 1;
+                        if (slot >= 0) node[k] = (int)cur.ref(slot);
+                    } else if (cur.flag() == 0) {
+                        if (slot < count && !cmp(key, cur.key(slot))) refsOut[order[k]] = cur.ref(slot);
+                    }
+                }
+                release(idx);
+            } else if (!stale) {
+                // Never written (a fresh mapping): nothing is below it, as
+                // in searchFixed().
+                for (size_t k = start; k < end; k++) node[k] = -1;
+            }
+            if (!stale && !validate(idx, version)) stale = true;
+
+            for (size_t k = start; k < end; k++) {
+                if (stale) {
+                    retry.push_back(order[k]);
+                    node[k] = -1;
+                    continue;
+                }
+                parent[k] = idx;
+                parentVersion[k] = version;
+                if (node[k] == -1 || !store->mapped()) continue;
+                const char *c = store->view(node[k]);
+                if (!c) continue;
+                for (int off = 0; off < min<long long>(bp.imageSize(), PREFETCH_BYTES); off += 64) __builtin_prefetch(c + off);
+            }
+        }
+    }
+
+    for (int i : retry) refsOut[i] = searchFrom(pin.root, ids[i]);
+}
+
+// The operation is committed when the scope of eraseOne() ends, so the
+// log's verdict is only known here.
+template<class K, class V, class Compare>
+bool BasicBTreeIndex<K, V, Compare>::erase(const K &RecordID) {
+    OpTimer timer(stats(), OpKind::Erase);
+    if (!mayHold(RecordID) || bp.logFailed()) return false;
+    if (deferred) return buryKeys({RecordID}) == 1;
+    bool erased = eraseOne(RecordID);
+    return erased && !bp.logFailed();
+}
+
+// Writers crab down with exclusive latches. A node that keeps more than
+// the minimum and whose max is not the key being deleted cannot pass a
+// change upwards, so everything above it is released.
+template<class K, class V, class Compare>
+bool BasicBTreeIndex<K, V, Compare>::eraseOne(const K &RecordID) {
+    WriteScope write(*this);
+    LatchSet latches(writerLatches(), true);
+    OpScope op(bp);
+    int minKeys = m / 2;
+
+    vector<int> path;
+    int curIdx = 1;
+    latches.lock(curIdx);
+    NodeType cur = readNode<K, V>(bp, curIdx, m);
+    if (cur.flag == -1) return false;
+
+    // 1. SEARCH
+    while (cur.flag != 0) {
+        path.push_back(curIdx);
+        if (cur.count == 0) return false;
+        int slot = firstKeyAtLeast(cur.key.data(), cur.count, RecordID, cmp);
+        if (slot == cur.count) slot = cur.count - 1;
+        curIdx = (int)cur.ref[slot];
+        latches.lock(curIdx);
+        cur = readNode<K, V>(bp, curIdx, m);
+        if (latches.active() && countKeys(cur) > minKeys && cmp(RecordID, getMaxKey(cur))) {
+            latches.unlockAllBut(curIdx);
+            path.clear();
+        }
+    }
+
+    // 2. DELETE FROM LEAF
+    int pos = firstKeyAtLeast(cur.key.data(), cur.count, RecordID, cmp);
+    if (pos == cur.count || cmp(RecordID, cur.key[pos])) return false;
+    bool dead = cur.ref[pos] == NOT_FOUND;   // a tombstone goes too, but the key was already gone
+    removeEntryAt(cur, pos);
+    if (!dead) filterRemove(RecordID);
+
+    writeAtNode(bp, curIdx, cur, m); // Goes to the pool, so the next read sees the change
+
+    // 3. PROPAGATE UPDATE UPWARDS
+    propagateMaxUp<K, V>(bp, path, curIdx, m, cmp);
+
+    // 4. CHECK UNDERFLOW
+    if (countKeys(cur) < minKeys) {
+        solveUnderflow<K, V>(bp, curIdx, path, m, latches, cmp);
+    }
+
+    return !dead;
+}
+
+template<class K, class V, class Compare>
+int BasicBTreeIndex<K, V, Compare>::insert(const K &RecID, const V &Ref) {
+    OpTimer timer(stats(), OpKind::Insert);
+    if (Ref == NOT_FOUND || bp.logFailed()) return -1;
+    int leafIdx = insertOne(RecID, Ref);
+    return bp.logFailed() ? -1 : leafIdx;
+}
+
+// Same crabbing as erase: a node with room to spare whose max already
+// covers the new key absorbs the insert, so its ancestors are released.
+template<class K, class V, class Compare>
+int BasicBTreeIndex<K, V, Compare>::insertOne(const K &RecID, const V &Ref) {
+    WriteScope write(*this);
+    LatchSet latches(writerLatches(), true);
+    OpScope op(bp);
+
+    latches.lock(1);
+    NodeType root = readNode<K, V>(bp, 1, m);
+
+    // --- 1. HANDLE FIRST INSERT (Uninitialized Root) ---
+    if (root.flag == -1) {
+        latches.lock(0);
+        FileHeader &head = headerIn(bp.pinForWrite(0));
+        if (head.freeHead == 1) {
+            // Detach Node 1 from free list
+            head.freeHead = root.next;
+        }
+        bp.unpin(0, true);
+        root.flag = 0;
+        root.count = 0;
+        root.next = -1;
+        appendEntry(root, RecID, Ref);
+        filterAdd(RecID);
+        writeAtNode(bp, 1, root, m);
+        noteInsert(1, 0);
+        return 1;
+    }
+
+    // --- 2. TRAVERSE TO LEAF ---
+    // A key past the last one goes to the rightmost leaf, so an append
+    // starts from the remembered spine while it is still current.
+    vector<int> path;
+    NodeType leaf(m);
+    if (!spine.empty() && spineShape == bp.shape()) {
+        leaf = readNode<K, V>(bp, spine.back(), m);
+        if (leaf.flag == 0 && leaf.count > 0 && cmp(getMaxKey(leaf), RecID)) path = spine;
+    }
+    if (path.empty()) {
+        int curIdx = 1;
+        while (true) {
+            path.push_back(curIdx);
+            NodeType cur = readNode<K, V>(bp, curIdx, m);
+            if (latches.active() && countKeys(cur) < bp.sureEntries() && cur.count > 0 &&
+                !cmp(getMaxKey(cur), RecID)) {
+                latches.unlockAllBut(curIdx);
+                path.assign(1, curIdx);
+            }
+            if (cur.flag == 0) break;
+
+            if (cur.count == 0) return -1;
+            int slot = firstKeyAtLeast(cur.key.data(), cur.count, RecID, cmp);
+            if (slot == cur.count) slot = cur.count - 1;
+            curIdx = (int)cur.ref[slot];
+            latches.lock(curIdx);
+        }
+        leaf = readNode<K, V>(bp, path.back(), m);
+        if (leaf.next == -1 && !latchTable && !shadow) {
+            spine = path;
+            spineShape = bp.shape();
+        }
+    }
+    int leafIdx = path.back();
+
+    // Check duplicates
+    int pos = firstKeyAtLeast(leaf.key.data(), leaf.count, RecID, cmp);
+    if (pos < leaf.count && !cmp(RecID, leaf.key[pos])) {
+        if (leaf.ref[pos] != NOT_FOUND) return -1;
+        // A tombstone: the key comes back in place, unless the new ref
+        // does not fit the packed slot; then it is inserted as a new key.
+        leaf.ref[pos] = Ref;
+        if (bp.fits(leaf)) {
+            filterAdd(RecID);
+            writeAtNode(bp, leafIdx, leaf, m);
+            noteInsert(leafIdx, pos);
+            return leafIdx;
+        }
+        removeEntryAt(leaf, pos);
+    }
+    filterAdd(RecID);
+
+    // --- 3. SIMPLE INSERT (No Split) ---
+    if (countKeys(leaf) < m && bp.fitsWith(leaf, RecID, Ref)) {
+        bool newMax = leaf.count == 0 || cmp(getMaxKey(leaf), RecID);
+        insertEntryAt(leaf, pos, RecID, Ref);
+        writeAtNode(bp, leafIdx, leaf, m);
+        noteInsert(leafIdx, pos);
+
+        // Update Parent Keys if Max Changed
+        if (newMax) {
+            path.pop_back();
+            propagateMaxUp<K, V>(bp, path, leafIdx, m, cmp);
+        }
+        return leafIdx;
+    }
+
+    // --- 4. SPLIT LOGIC ---
+    // The leaf's entries and the new one at pos (m+1 items, fewer if a
+    // packed leaf ran out of room first)
+    int n = leaf.count + 1;
+    bool rightEdge = leaf.next == -1;
+    int run = runAt(leafIdx, pos, n, rightEdge);
+    int mid = splitPoint(n, pos, run, true);
+    bool inRight = pos >= mid;
+    if (mid != n / 2) bp.stats().bump(Counter::RunSplits);
+    auto placed = [&](int node) {
+        noteInsert(node, inRight ? pos - mid : pos);
+        return node;
+    };
+
+    // *** SPECIAL CASE: ROOT SPLIT (Node 1) ***
+    // We handle this explicitly to enforce Node 2 = Left, Node 3 = Right
+    if (leafIdx == 1) {
+        int leftNodeIdx = allocateNode(bp, latches);  // Guaranteed Node 2
+        int rightNodeIdx = allocateNode(bp, latches); // Guaranteed Node 3
+
+        NodeType &leftNode = leaf;   // the root's entries stay in the left half
+        NodeType rightNode(m);
+        rightNode.flag = 0; // Both are leaves
+        leftNode.next = rightNodeIdx;
+
+        // Distribute Data
+        splitInsertAt(leftNode, rightNode, mid, pos, RecID, Ref);
+
+        // Write Children
+        writeAtNode(bp, leftNodeIdx, leftNode, m);
+        writeAtNode(bp, rightNodeIdx, rightNode, m);
+
+        // Rewrite Root (Node 1) as Parent
+        NodeType newRoot(m);
+        newRoot.flag = 1;
+        appendEntry(newRoot, getMaxKey(leftNode), (V)leftNodeIdx);
+        appendEntry(newRoot, getMaxKey(rightNode), (V)rightNodeIdx);
+
+        writeAtNode(bp, 1, newRoot, m);
+        bp.stats().bump(Counter::LeafSplits);
+        bp.reshaped();
+        bp.stats().bump(Counter::RootSplits);
+
+        // Return the actual location of the record
+        return placed(inRight ? rightNodeIdx : leftNodeIdx);
+    }
+
+    // *** NORMAL SPLIT (Not Root) ***
+    int rightIdx = allocateNode(bp, latches, leafIdx);
+    NodeType rightNode(m);
+    rightNode.flag = leaf.flag;
+    rightNode.next = leaf.next;
+    leaf.next = rightIdx;
+
+    splitInsertAt(leaf, rightNode, mid, pos, RecID, Ref);
+
+    writeAtNode(bp, leafIdx, leaf, m);
+    writeAtNode(bp, rightIdx, rightNode, m);
+    bp.stats().bump(Counter::LeafSplits);
+    bp.reshaped();
+
+    int returnIdx = inRight ? rightIdx : leafIdx;
+
+    K leftMax = getMaxKey(leaf);
+    K rightMax = getMaxKey(rightNode);
+    int childIdxLeft = leafIdx;
+    int childIdxRight = rightIdx;
+
+    path.pop_back();
+
+    // Propagate Up
+    while (true) {
+        if (path.empty()) {
+            // Root Split (Upper Level)
+            // If an INTERNAL node splits and propagates to root
+            int newLeftIdx = allocateNode(bp, latches);
+            NodeType newLeft = readNode<K, V>(bp, childIdxLeft, m);
+            writeAtNode(bp, newLeftIdx, newLeft, m);
+
+            if (returnIdx == childIdxLeft) returnIdx = newLeftIdx;
+
+            NodeType newRoot(m);
+            newRoot.flag = 1;
+            appendEntry(newRoot, leftMax, (V)newLeftIdx);
+            appendEntry(newRoot, rightMax, (V)childIdxRight);
+
+            writeAtNode(bp, 1, newRoot, m);
+            bp.stats().bump(Counter::RootSplits);
+            bp.reshaped();
+            return placed(returnIdx);
+        }
+
+        int parentIdx = path.back();
+        path.pop_back();
+        NodeType parent = readNode<K, V>(bp, parentIdx, m);
+
+        // The split child keeps its place with its new max; the new node
+        // goes right after it.
+        int at = 0;
+        while (at < parent.count && parent.ref[at] != (V)childIdxLeft) at++;
+        if (at < parent.count) parent.key[at++] = leftMax;
+        int pn = parent.count + 1;
+
+        if (pn <= m) {
+            insertEntryAt(parent, at, rightMax, (V)childIdxRight);
+            if (bp.fits(parent)) {
+                writeAtNode(bp, parentIdx, parent, m);
+                noteInsert(parentIdx, at);
+                // A key past the parent's last one can still be routed here
+                // (its own key above it is a stale, larger bound), so the
+                // new last child may raise the parent's max.
+                if (at == parent.count - 1) propagateMaxUp<K, V>(bp, path, parentIdx, m, cmp);
+                return placed(returnIdx);
+            }
+            removeEntryAt(parent, at);
+        }
+
+        rightEdge = rightEdge && at == pn - 1;
+        int pMid = splitPoint(pn, at, runAt(parentIdx, at, pn, rightEdge), false);
+        if (pMid != pn / 2) bp.stats().bump(Counter::RunSplits);
+        int pRightIdx = allocateNode(bp, latches, parentIdx);
+        NodeType pRight(m); pRight.flag = 1;
+
+        splitInsertAt(parent, pRight, pMid, at, rightMax, (V)childIdxRight);
+
+        writeAtNode(bp, parentIdx, parent, m);
+        writeAtNode(bp, pRightIdx, pRight, m);
+        bp.stats().bump(Counter::InternalSplits);
+        bp.reshaped();
+        if (at < pMid) noteInsert(parentIdx, at);
+        else noteInsert(pRightIdx, at - pMid);
+
+        leftMax = getMaxKey(parent);
+        rightMax = getMaxKey(pRight);
+        childIdxLeft = parentIdx;
+        childIdxRight = pRightIdx;
+    }
+}
+
+// Root-to-leaf descent for 'key' (with 'after', for the keys ordered after
+// it). Fills 'path' with the internal nodes visited and 'hi' with the
+// largest key that still routes to the returned leaf (none on the right
+// edge). Returns -1 on an empty tree. Shared latches are coupled down the
+// path, leaving only the leaf latched; exclusive ones are all kept.
+// Readers of a pinned version start from its root instead of Node 1.
+template<class K, class V, class Compare>
+int BasicBTreeIndex<K, V, Compare>::descend(const K &key, bool after, vector<int> &path, optional<K> &hi,
+                                            LatchSet &latches, int root) {
+    path.clear();
+    hi.reset();
+    int curIdx = root;
+    latches.lock(curIdx);
+    NodeType cur = readNode<K, V>(bp, curIdx, m);
+    if (cur.flag == -1) return -1;
+
+    while (cur.flag != 0) {
+        path.push_back(curIdx);
+        int last = countKeys(cur) - 1;
+        if (last < 0) return -1;
+        int slot = after ? firstKeyAbove(cur.key.data(), last, key, cmp)
+                         : firstKeyAtLeast(cur.key.data(), last, key, cmp);
+        if (slot != last && (!hi || cmp(cur.key[slot], *hi))) hi = cur.key[slot];
+        curIdx = (int)cur.ref[slot];
+        latches.lock(curIdx);
+        if (!latches.isExclusive()) latches.unlock(path.back());
+        cur = readNode<K, V>(bp, curIdx, m);
+    }
+    return curIdx;
+}
+
+// Copy of the leaf that 'key' routes to, taken under its latch, and the
+// leaf's routing upper bound in 'hi'. Returns the leaf index, or -1 on an
+// empty tree.
+template<class K, class V, class Compare>
+int BasicBTreeIndex<K, V, Compare>::readLeaf(const K &key, bool after, NodeType &leaf, optional<K> &hi, int root) {
+    LatchSet latches(writerLatches(), false);
+    vector<int> path;
+    int leafIdx = descend(key, after, path, hi, latches, root);
+    if (leafIdx != -1) leaf = readNode<K, V>(bp, leafIdx, m);
+    return leafIdx;
+}
+
+// Insert many records with one descent per target leaf: every record that
+// routes to the same leaf is added in one write and one max-key fixup.
+// Only a record that finds its leaf full takes the single-insert split path.
+// Returns the number of records inserted (duplicates are skipped). On a
+// concurrent handle each leaf group is its own operation, with its whole
+// path latched, so no latch is held from one group to the next.
+template<class K, class V, class Compare>
+int BasicBTreeIndex<K, V, Compare>::insertBatch(vector<pair<K, V>> records) {
+    OpTimer timer(stats(), OpKind::InsertBatch);
+    if (bp.logFailed()) return -1;
+    optional<OpScope> whole;
+    if (!latchTable) whole.emplace(bp);
+    erase_if(records, [&](const pair<K, V> &r) { return r.second == NOT_FOUND; });
+    sort(records.begin(), records.end(), pairOrder<K, V>(cmp));
+    int inserted = 0;
+    vector<int> path;
+    size_t i = 0;
+    while (i < records.size() && !bp.logFailed()) {
+        bool split = false;
+        {
+            WriteScope write(*this);
+            LatchSet latches(writerLatches(), true);
+            OpScope op(bp);
+            optional<K> hi;
+            int leafIdx = descend(records[i].first, false, path, hi, latches);
+            auto routed = [&](const K &key) { return !hi || !cmp(*hi, key); };
+            if (leafIdx == -1) {
+                split = true;
+            } else {
+                NodeType leaf = readNode<K, V>(bp, leafIdx, m);
+                bool hadMax = leaf.count > 0;
+                K oldMax = hadMax ? getMaxKey(leaf) : K();
+                bool changed = false;
+                int addedAt = -1;
+                while (i < records.size() && routed(records[i].first)) {
+                    const K &key = records[i].first;
+                    int at = firstKeyAtLeast(leaf.key.data(), leaf.count, key, cmp);
+                    if (at < leaf.count && keyEq(leaf.key[at], key, cmp)) {
+                        if (leaf.ref[at] == NOT_FOUND) {
+                            leaf.ref[at] = records[i].second;
+                            filterAdd(key);
+                            changed = true;
+                            inserted++;
+                        }
+                        i++;
+                        continue;
+                    }
+                    if (leaf.count == m || !bp.fitsWith(leaf, key, records[i].second)) break;
+                    insertEntryAt(leaf, at, key, records[i].second);
+                    filterAdd(key);
+                    addedAt = at;
+                    changed = true;
+                    inserted++;
+                    i++;
+                }
+                if (changed) {
+                    writeAtNode(bp, leafIdx, leaf, m);
+                    if (!hadMax || !keyEq(getMaxKey(leaf), oldMax, cmp)) propagateMaxUp<K, V>(bp, path, leafIdx, m, cmp);
+                }
+                if (addedAt != -1) noteInsert(leafIdx, addedAt);
+                // Leaf is full: this record needs a split.
+                split = i < records.size() && routed(records[i].first);
+            }
+        }
+        if (split) {
+            if (insert(records[i].first, records[i].second) != -1) inserted++;
+            i++;
+        }
+    }
+    whole.reset();
+    return bp.logFailed() ? -1 : inserted;
+}
+
+// Delete many keys with one descent per target leaf. Keys are removed from
+// a leaf in one pass until the next removal would underflow it; that last
+// removal is followed by a single solveUnderflow before re-descending.
+// Returns the number of keys deleted. Groups commit separately on a
+// concurrent handle, as in insertBatch. With deferred deletes the keys
+// become tombstones instead.
+template<class K, class V, class Compare>
+int BasicBTreeIndex<K, V, Compare>::eraseBatch(vector<K> ids) {
+    OpTimer timer(stats(), OpKind::EraseBatch);
+    if (bloom) erase_if(ids, [&](const K &key) { return !mayHold(key); });
+    return deferred ? buryKeys(std::move(ids)) : removeKeys(std::move(ids), false);
+}
+
+// The removal pass of eraseBatch, also used by maintain(). With
+// tombstonesOnly an entry goes only if it is still a tombstone (its key
+// may have been inserted again since), and tombstones are counted;
+// otherwise live keys are.
+template<class K, class V, class Compare>
+int BasicBTreeIndex<K, V, Compare>::removeKeys(vector<K> ids, bool tombstonesOnly) {
+    if (bp.logFailed()) return -1;
+    optional<OpScope> whole;
+    if (!latchTable) whole.emplace(bp);
+    sort(ids.begin(), ids.end(), cmp);
+    ids.erase(unique(ids.begin(), ids.end(), [&](const K &a, const K &b) { return keyEq(a, b, cmp); }), ids.end());
+    int minKeys = m / 2;
+    int removed = 0;
+    vector<int> path;
+    size_t i = 0;
+    while (i < ids.size() && !bp.logFailed()) {
+        WriteScope write(*this);
+        LatchSet latches(writerLatches(), true);
+        OpScope op(bp);
+        optional<K> hi;
+        int leafIdx = descend(ids[i], false, path, hi, latches);
+        if (leafIdx == -1) break;
+
+        NodeType leaf = readNode<K, V>(bp, leafIdx, m);
+        K oldMax = leaf.count > 0 ? getMaxKey(leaf) : K();
+        bool changed = false;
+        bool underflow = false;
+        while (i < ids.size() && (!hi || !cmp(*hi, ids[i])) && !underflow) {
+            for (int k = 0; k < leaf.count; k++) {
+                if (keyEq(leaf.key[k], ids[i], cmp)) {
+                    bool dead = leaf.ref[k] == NOT_FOUND;
+                    if (tombstonesOnly && !dead) break;
+                    removeEntryAt(leaf, k);
+                    if (!dead) filterRemove(ids[i]);
+                    if (dead == tombstonesOnly) removed++;
+                    changed = true;
+                    underflow = !path.empty() && leaf.count < minKeys;
+                    break;
+                }
+            }
+            i++;
+        }
+        if (!changed) continue;
+
+        writeAtNode(bp, leafIdx, leaf, m);
+        if (leaf.count > 0 && !keyEq(getMaxKey(leaf), oldMax, cmp)) propagateMaxUp<K, V>(bp, path, leafIdx, m, cmp);
+        if (underflow) solveUnderflow<K, V>(bp, leafIdx, path, m, latches, cmp);
+    }
+    whole.reset();
+    return bp.logFailed() ? -1 : removed;
+}
+
+// Deferred erase: one descent per target leaf, whose entries for ids turn
+// into tombstones in a single write. Nothing above the leaf changes, so
+// its ancestors are let go as soon as it is reached. A tombstone that
+// would not fit a packed slot is not made; that key is removed at once.
+template<class K, class V, class Compare>
+int BasicBTreeIndex<K, V, Compare>::buryKeys(vector<K> ids) {
+    if (bp.logFailed()) return -1;
+    sort(ids.begin(), ids.end(), cmp);
+    ids.erase(unique(ids.begin(), ids.end(), [&](const K &a, const K &b) { return keyEq(a, b, cmp); }), ids.end());
+    vector<K> buried, unfit;
+    {
+        optional<OpScope> whole;
+        if (!latchTable) whole.emplace(bp);
+        vector<int> path;
+        size_t i = 0;
+        while (i < ids.size() && !bp.logFailed()) {
+            WriteScope write(*this);
+            LatchSet latches(writerLatches(), true);
+            OpScope op(bp);
+            optional<K> hi;
+            int leafIdx = descend(ids[i], false, path, hi, latches);
+            if (leafIdx == -1) break;
+            latches.unlockAllBut(leafIdx);
+
+            NodeType leaf = readNode<K, V>(bp, leafIdx, m);
+            bool changed = false;
+            while (i < ids.size() && (!hi || !cmp(*hi, ids[i]))) {
+                const K &key = ids[i++];
+                int pos = firstKeyAtLeast(leaf.key.data(), leaf.count, key, cmp);
+                if (pos == leaf.count || cmp(key, leaf.key[pos]) || leaf.ref[pos] == NOT_FOUND) continue;
+                V ref = leaf.ref[pos];
+                leaf.ref[pos] = NOT_FOUND;
+                if (!bp.fits(leaf)) {
+                    leaf.ref[pos] = ref;
+                    unfit.push_back(key);
+                    continue;
+                }
+                filterRemove(key);
+                buried.push_back(key);
+                changed = true;
+            }
+            if (changed) writeAtNode(bp, leafIdx, leaf, m);
+        }
+    }
+    if (bp.logFailed()) return -1;
+    int erased = (int)buried.size();
+    if (!unfit.empty()) {
+        int removed = removeKeys(std::move(unfit), false);
+        if (removed == -1) return -1;
+        erased += removed;
+    }
+    if (buried.empty()) return erased;
+
+    stats().bump(Counter::Tombstones, buried.size());
+    bool due;
+    {
+        lock_guard<mutex> lk(pendingLock);
+        pending.insert(pending.end(), buried.begin(), buried.end());
+        due = pending.size() >= PURGE_BATCH;
+    }
+    if (due && maintainer.joinable()) pendingReady.notify_one();
+    else if (due) maintain();
+    return erased;
+}
+
+template<class K, class V, class Compare>
+int BasicBTreeIndex<K, V, Compare>::maintain() {
+    vector<K> keys;
+    {
+        lock_guard<mutex> lk(pendingLock);
+        keys.swap(pending);
+    }
+    if (keys.empty()) return 0;
+    int purged = removeKeys(std::move(keys), true);
+    if (purged == -1) return -1;
+    stats().bump(Counter::Purges, purged);
+    return purged;
+}
+
+// Concurrent handles: purge whenever a batch is waiting, and at least
+// every PURGE_INTERVAL while anything is.
+template<class K, class V, class Compare>
+void BasicBTreeIndex<K, V, Compare>::maintenanceLoop() {
+    unique_lock<mutex> lk(pendingLock);
+    while (!stopping) {
+        pendingReady.wait_for(lk, PURGE_INTERVAL, [&] { return stopping || pending.size() >= PURGE_BATCH; });
+        if (stopping || pending.empty()) continue;
+        lk.unlock();
+        maintain();
+        lk.lock();
+    }
+}
+
+template<class K, class V, class Compare>
+BasicRangeScan<K, V, Compare> BasicBTreeIndex<K, V, Compare>::openScan(const K &lo, const K &hi) {
+    return BasicRangeScan<K, V, Compare>(*this, lo, hi, SnapshotPin(shadow.get()));
+}
+
+// All (key, ref) pairs with lo <= key <= hi, in key order.
+template<class K, class V, class Compare>
+vector<pair<K, V>> BasicBTreeIndex<K, V, Compare>::scan(const K &lo, const K &hi) {
+    OpTimer timer(stats(), OpKind::Scan);
+    vector<pair<K, V>> out;
+    BasicRangeScan<K, V, Compare> it = openScan(lo, hi);
+    K key;
+    V ref;
+    while (it.next(key, ref)) out.push_back({key, ref});
+    return out;
+}
+
+template<class K, class V, class Compare>
+BasicRangeScan<K, V, Compare>::BasicRangeScan(BasicBTreeIndex<K, V, Compare> &idx, const K &lo, const K &hi,
+                                              SnapshotPin pin)
+    : idx(&idx), m(idx.m), leaf(idx.m), hi(hi), pin(std::move(pin)) {
+    if (!idx.cmp(hi, lo)) load(lo, false);
+}
+
+// Position on the leaf that 'from' routes to, at its first key >= from
+// (with 'after': the leaf of the keys past 'from', at its first key > from).
+template<class K, class V, class Compare>
+void BasicRangeScan<K, V, Compare>::load(const K &from, bool after) {
+    leafIdx = idx->readLeaf(from, after, leaf, bound, pin.root);
+    pos = 0;
+    if (leafIdx == -1) return;
+    pos = after ? firstKeyAbove(leaf.key.data(), leaf.count, from, idx->cmp)
+                : firstKeyAtLeast(leaf.key.data(), leaf.count, from, idx->cmp);
+}
+
+template<class K, class V, class Compare>
+bool BasicRangeScan<K, V, Compare>::next(K &key, V &ref) {
+    while (leafIdx != -1) {
+        if (pos < leaf.count) {
+            if (idx->cmp(hi, leaf.key[pos])) { leafIdx = -1; return false; }
+            if (leaf.ref[pos] == BasicBTreeIndex<K, V, Compare>::NOT_FOUND) {   // tombstone
+                pos++;
+                continue;
+            }
+            key = leaf.key[pos];
+            ref = leaf.ref[pos];
+            pos++;
+            return true;
+        }
+        if (idx->latchTable || idx->shadow) {   // copies do not relink the leaf chain
+            if (!bound || !idx->cmp(*bound, hi)) { leafIdx = -1; return false; }
+            K from = *bound;   // load() replaces bound
+            load(from, true);
+            continue;
+        }
+        leafIdx = leaf.next;
+        pos = 0;
+        if (leafIdx != -1) leaf = readNode<K, V>(idx->bp, leafIdx, m);
+    }
+    return false;
+}
+
+template<class K, class V, class Compare>
+V BasicSnapshot<K, V, Compare>::search(const K &RecordID) {
+    OpTimer timer(idx->stats(), OpKind::Search);
+    return idx->searchFrom(pin.root, RecordID);
+}
+
+template<class K, class V, class Compare>
+BasicRangeScan<K, V, Compare> BasicSnapshot<K, V, Compare>::openScan(const K &lo, const K &hi) {
+    return BasicRangeScan<K, V, Compare>(*idx, lo, hi, pin);
+}
+
+template<class K, class V, class Compare>
+vector<pair<K, V>> BasicSnapshot<K, V, Compare>::scan(const K &lo, const K &hi) {
+    OpTimer timer(idx->stats(), OpKind::Scan);
+    vector<pair<K, V>> out;
+    BasicRangeScan<K, V, Compare> it = openScan(lo, hi);
+    K key;
+    V ref;
+    while (it.next(key, ref)) out.push_back({key, ref});
+    return out;
+}
+
+// Walk 'op' down through resident nodes until it finishes or needs a read.
+template<class K, class V, class Compare>
+void BasicAsyncIndex<K, V, Compare>::start(Op op) {
+    BasicBTreeIndex<K, V, Compare> &t = idx;
+    constexpr V NOT_FOUND = BasicBTreeIndex<K, V, Compare>::NOT_FOUND;
+    if (!op.isInsert && !t.mayHold(op.key)) {
+        op.done(NOT_FOUND);
+        return;
+    }
+    if (t.store->mapped() || t.latchTable || t.shadow || t.store->descriptor() < 0) {
+        op.done(op.isInsert ? (V)t.insert(op.key, op.ref) : t.search(op.key));
+        return;
+    }
+    if (op.node == 1) op.reshapes = reshapes();
+    while (true) {
+        const char *p = t.bp.pinIfCached(op.node);
+        if (!p) {
+            park(std::move(op));
+            return;
+        }
+        NodeView<K, V> cur{p, t.m};
+        int count = cur.count();
+        int slot = firstKeyAtLeast(cur.keys(), count, op.key, t.cmp);
+        if (cur.flag() == 1) {
+            int nextIdx = -1;
+            if (slot == count) slot = count - 1;
+            if (slot >= 0) nextIdx = (int)cur.ref(slot);
+            t.bp.unpin(op.node, false);
+            if (nextIdx == -1 && !op.isInsert && op.reshapes != reshapes()) {
+                op.node = 1;
+                op.reshapes = reshapes();
+                continue;
+            }
+            if (nextIdx == -1) {
+                op.done(op.isInsert ? (V)t.insert(op.key, op.ref) : NOT_FOUND);
+                return;
+            }
+            op.node = nextIdx;
+            continue;
+        }
+
+        V result = NOT_FOUND;
+        if (!op.isInsert && cur.flag() == 0 && slot < count && !t.cmp(op.key, cur.key(slot))) result = cur.ref(slot);
+        t.bp.unpin(op.node, false);
+        if (!op.isInsert && result == NOT_FOUND && op.reshapes != reshapes()) {
+            op.node = 1;
+            op.reshapes = reshapes();
+            continue;
+        }
+        if (op.isInsert) result = t.insert(op.key, op.ref);
+        op.done(result);
+        return;
+    }
+}
+
+template<class K, class V, class Compare>
+void BasicAsyncIndex<K, V, Compare>::park(Op op) {
+    auto [it, fresh] = reads.try_emplace(op.node);
+    it->second.waiting.push_back(std::move(op));
+    parked++;
+    if (fresh) unsubmitted.push_back(it->first);
+}
+
+template<class K, class V, class Compare>
+int BasicAsyncIndex<K, V, Compare>::poll(bool wait) {
+    BasicBTreeIndex<K, V, Compare> &t = idx;
+    long long nodeBytes = t.bp.imageSize();
+    if (!unsubmitted.empty()) t.store->flush();   // pool write-backs still buffered
+    while (!unsubmitted.empty() && inFlight < depth) {
+        int node = unsubmitted.front();
+        unsubmitted.pop_front();
+        Read &r = reads[node];
+        r.image.assign(nodeBytes, 0);
+        r.writesAtSubmit = t.bp.storeWrites();
+        io->submit({false, t.store->descriptor(), r.image.data(), (unsigned)nodeBytes,
+                    (long long)node * t.store->slotStride(), (unsigned long long)node});
+        inFlight++;
+    }
+
+    vector<IoCompletion> done;
+    io->reap(done, wait && inFlight > 0);
+    for (IoCompletion &c : done) {
+        inFlight--;
+        auto it = reads.find((int)c.tag);
+        int node = it->first;
+        Read r = std::move(it->second);
+        reads.erase(it);
+        parked -= (int)r.waiting.size();
+        if (c.result < 0) {
+            // Failed read: finish these operations the blocking way.
+            for (Op &op : r.waiting) op.done(op.isInsert ? (V)t.insert(op.key, op.ref) : t.search(op.key));
+            continue;
+        }
+        if (c.result != nodeBytes) emptyImage(r.image.data(), nodeBytes);   // past the end of the file
+        // A write-back since the submit may have raced the read: leave it
+        // uncached and let the operations read the node again.
+        if (r.writesAtSubmit == t.bp.storeWrites()) t.bp.install(node, r.image.data());
+        for (Op &op : r.waiting) start(std::move(op));
+    }
+    return parked;
+}
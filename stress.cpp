@@ -0,0 +1,557 @@
+// stress.cpp
+// Multi-threaded insert/erase stress test for a concurrent handle. Each
+// thread owns the keys congruent to its number, so the expected contents
+// are known exactly while splits, merges and free-list traffic from all
+// threads interleave on shared nodes. A run that does not finish in time
+// counts as a deadlock. Later runs kill a logged handle mid-workload and
+// check what the log replays, and cut off a log write halfway; the last
+// ones use a composite key type, reset the counters under an append
+// workload, look up keys in a file that was never written to and stop a
+// mapped file from growing.
+//
+//   btree-stress [--threads T] [--ops N] [--keys K] [--m M] [--seed S]
+
+#include "btree_impl.h"
+
+#include <cstdio>
+#include <numeric>
+#include <sstream>
+#include <csignal>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+struct StressConfig {
+    int threads = 8;
+    int ops = 20000;      // per thread
+    int keys = 2000;
+    int m = MIN_ORDER;    // small nodes: most operations split or merge
+    unsigned seed = 42;
+    string file = "btree-stress.idx";
+};
+
+static constexpr chrono::seconds STRESS_TIMEOUT{60};
+
+static void removeFiles(const string &file) {
+    filesystem::remove(file);
+    filesystem::remove(file + ".wal");
+    filesystem::remove(file + ".bloom");
+}
+
+// One mode: random inserts and erases from every thread, then a check of
+// every key and of a full scan against what the threads say they left.
+static bool runMode(const StressConfig &cfg, const char *name, IndexOptions opts) {
+    removeFiles(cfg.file);
+    string file = cfg.file;
+    CreateIndexFileFile(file.data(), 2, cfg.m);
+    opts.concurrent = true;
+
+    vector<map<int, int>> owned(cfg.threads);
+    atomic<int> failures{0};
+    {
+        BTreeIndex idx(file.c_str(), opts);
+        if (!idx.isOpen()) {
+            cerr << name << ": cannot open " << cfg.file << "\n";
+            return false;
+        }
+        atomic<int> running{cfg.threads};
+        vector<thread> workers;
+        for (int t = 0; t < cfg.threads; t++) {
+            workers.emplace_back([&, t] {
+                mt19937 rng(cfg.seed + t);
+                map<int, int> &mine = owned[t];
+                int slots = (cfg.keys - t + cfg.threads - 1) / cfg.threads;
+                for (int i = 0; i < cfg.ops; i++) {
+                    int key = (int)(rng() % slots) * cfg.threads + t;
+                    if (rng() % 2) {
+                        bool had = mine.count(key);
+                        bool added = idx.insert(key, i) != -1;
+                        if (added == had) failures++;
+                        if (added) mine[key] = i;
+                    } else {
+                        if (idx.erase(key) != (bool)mine.erase(key)) failures++;
+                    }
+                }
+                running--;
+            });
+        }
+
+        auto deadline = chrono::steady_clock::now() + STRESS_TIMEOUT;
+        while (running > 0 && chrono::steady_clock::now() < deadline) this_thread::sleep_for(chrono::milliseconds(10));
+        if (running > 0) {
+            // The workers cannot be stopped, so neither can the process.
+            fflush(stdout);
+            fprintf(stderr, "%s: %d threads still running after %llds, deadlocked\n", name, running.load(),
+                    (long long)STRESS_TIMEOUT.count());
+            _exit(1);
+        }
+        for (thread &w : workers) w.join();
+
+        map<int, int> expected;
+        for (auto &mine : owned) expected.insert(mine.begin(), mine.end());
+        for (int key = 0; key < cfg.keys; key++) {
+            auto it = expected.find(key);
+            if (idx.search(key) != (it == expected.end() ? BTreeIndex::NOT_FOUND : it->second)) failures++;
+        }
+        vector<pair<int, int>> all = idx.scan(0, cfg.keys);
+        if (all != vector<pair<int, int>>(expected.begin(), expected.end())) failures++;
+        printf("%-10s %6zu keys left  %s\n", name, expected.size(), failures ? "FAILED" : "ok");
+    }
+    removeFiles(cfg.file);
+    return failures == 0;
+}
+
+// Every node after the header must be in the tree or on the free list,
+// once, and never in both.
+static bool nodesAccountedFor(const string &file) {
+    auto store = openStore(file.c_str(), StorageMode::File);
+    int m = getM<int, int>(*store);
+    if (m == 0) return false;
+    BufferPool bp(*store, store->imageSize());
+    FileHeader head = headerIn(bp.pin(0));
+    bp.unpin(0, false);
+
+    vector<int> seen(head.nodeCount, 0);
+    bool ok = true;
+    auto visit = [&](int idx) {
+        if (idx < 1 || idx >= head.nodeCount || seen[idx]++) ok = false;
+        return ok;
+    };
+    vector<int> stack{head.root};
+    while (!stack.empty()) {
+        int idx = stack.back();
+        stack.pop_back();
+        BasicNode<int, int> n = readNode<int, int>(bp, idx, m);
+        if (n.flag == -1) break;   // empty tree: the root is on the free list
+        if (!visit(idx)) break;
+        if (n.flag == 1) stack.insert(stack.end(), n.ref.begin(), n.ref.begin() + n.count);
+    }
+    for (int idx = head.freeHead; idx != -1 && visit(idx);) {
+        idx = headIn(bp.pin(idx)).next;
+        bp.unpin(idx, false);
+    }
+    return ok && count(seen.begin() + 1, seen.end(), 1) == head.nodeCount - 1;
+}
+
+// What the crashing workload did to one key: the value after its last
+// operation that returned, and the value an operation still running would
+// leave (NO_OP if there is none).
+struct KeyOutcome {
+    atomic<int> done;
+    atomic<int> pending;
+};
+
+static constexpr int NO_OP = INT_MIN;
+
+// WAL replay: a child process runs the workload on a logged concurrent
+// handle, checkpointing as it goes, and kills itself right after a
+// checkpoint once half of it is done. Reopening the file replays
+// the log; every operation that returned must be there, one in flight may
+// or may not be, and no node may be lost or both in use and free.
+static bool runCrash(const StressConfig &cfg) {
+    const char *name = "wal-replay";
+    removeFiles(cfg.file);
+    string file = cfg.file;
+    CreateIndexFileFile(file.data(), 2, cfg.m);
+
+    // Shared with the child, which cannot report any other way once killed
+    size_t bytes = sizeof(KeyOutcome) * cfg.keys + sizeof(atomic<long long>);
+    void *shared = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) {
+        cerr << name << ": cannot map shared memory\n";
+        return false;
+    }
+    KeyOutcome *outcome = static_cast<KeyOutcome*>(shared);
+    for (int key = 0; key < cfg.keys; key++) {
+        new (&outcome[key].done) atomic<int>(BTreeIndex::NOT_FOUND);
+        new (&outcome[key].pending) atomic<int>(NO_OP);
+    }
+    atomic<long long> *finished = new (outcome + cfg.keys) atomic<long long>(0);
+
+    long long target = (long long)cfg.ops * cfg.threads / 2;
+    fflush(stdout);
+    pid_t child = fork();
+    if (child == 0) {
+        IndexOptions opts;
+        opts.concurrent = true;
+        opts.writeAheadLog = true;
+        BTreeIndex idx(file.c_str(), opts);
+        if (!idx.isOpen()) _exit(1);
+        vector<thread> workers;
+        for (int t = 0; t < cfg.threads; t++) {
+            workers.emplace_back([&, t] {
+                mt19937 rng(cfg.seed + t);
+                int slots = (cfg.keys - t + cfg.threads - 1) / cfg.threads;
+                for (int i = 0;; i++) {   // until killed
+                    int key = (int)(rng() % slots) * cfg.threads + t;
+                    KeyOutcome &k = outcome[key];
+                    if (rng() % 2) {
+                        k.pending = i;
+                        if (idx.insert(key, i) != -1) k.done = i;
+                    } else {
+                        k.pending = BTreeIndex::NOT_FOUND;
+                        idx.erase(key);
+                        k.done = BTreeIndex::NOT_FOUND;
+                    }
+                    k.pending = NO_OP;
+                    (*finished)++;
+                }
+            });
+        }
+        // Checkpoints race the workers; the last one leaves the operations
+        // still running with images only in the pool.
+        while (true) {
+            this_thread::sleep_for(chrono::milliseconds(2));
+            idx.sync();
+            if (*finished >= target) raise(SIGKILL);
+        }
+    }
+
+    auto deadline = chrono::steady_clock::now() + STRESS_TIMEOUT;
+    while (chrono::steady_clock::now() < deadline && waitpid(child, nullptr, WNOHANG) == 0)
+        this_thread::sleep_for(chrono::milliseconds(1));
+    kill(child, SIGKILL);
+    waitpid(child, nullptr, 0);
+    long long reached = *finished;
+    if (reached < target) {
+        fprintf(stderr, "%s: child stopped after %lld of %lld operations\n", name, reached, target);
+        munmap(shared, bytes);
+        return false;
+    }
+
+    int failures = 0;
+    map<int, int> found;
+    {
+        IndexOptions opts;
+        opts.writeAheadLog = true;
+        BTreeIndex idx(file.c_str(), opts);
+        if (!idx.isOpen()) {
+            cerr << name << ": cannot reopen " << cfg.file << "\n";
+            munmap(shared, bytes);
+            return false;
+        }
+        for (int key = 0; key < cfg.keys; key++) {
+            int ref = idx.search(key);
+            if (ref != outcome[key].done && ref != outcome[key].pending) failures++;
+            if (ref != BTreeIndex::NOT_FOUND) found[key] = ref;
+        }
+        if (idx.scan(0, cfg.keys) != vector<pair<int, int>>(found.begin(), found.end())) failures++;
+    }
+    if (!nodesAccountedFor(file)) failures++;
+    printf("%-10s %6zu keys left  %s\n", name, found.size(), failures ? "FAILED" : "ok");
+    munmap(shared, bytes);
+    removeFiles(cfg.file);
+    return failures == 0;
+}
+
+// A log that cannot be written: a child logs some inserts, then caps its
+// file size so the next record's write comes up short. That insert and
+// every later write must fail. Reopening replays the inserts logged before.
+static bool runLogFull(const StressConfig &cfg) {
+    const char *name = "wal-full";
+    removeFiles(cfg.file);
+    string file = cfg.file;
+    CreateIndexFileFile(file.data(), 2, cfg.m);
+    int logged = min(cfg.keys / 2, 200);
+
+    fflush(stdout);
+    pid_t child = fork();
+    if (child == 0) {
+        IndexOptions opts;
+        opts.writeAheadLog = true;
+        BTreeIndex idx(file.c_str(), opts);
+        if (!idx.isOpen()) _exit(1);
+        for (int key = 0; key < logged; key++) {
+            if (idx.insert(key, key) == -1) _exit(1);
+        }
+        signal(SIGXFSZ, SIG_IGN);
+        rlimit limit;
+        getrlimit(RLIMIT_FSIZE, &limit);
+        limit.rlim_cur = filesystem::file_size(file + ".wal") + 64;
+        setrlimit(RLIMIT_FSIZE, &limit);
+        if (idx.insert(logged, logged) != -1) _exit(2);
+        if (idx.insert(logged + 1, logged + 1) != -1 || idx.erase(0)) _exit(3);
+        _exit(0);   // gone without a checkpoint
+    }
+
+    auto deadline = chrono::steady_clock::now() + STRESS_TIMEOUT;
+    int status = 0;
+    while (chrono::steady_clock::now() < deadline && waitpid(child, &status, WNOHANG) == 0)
+        this_thread::sleep_for(chrono::milliseconds(1));
+    if (kill(child, SIGKILL) == 0) {
+        waitpid(child, nullptr, 0);
+        fprintf(stderr, "%s: child still running after %llds\n", name, (long long)STRESS_TIMEOUT.count());
+        return false;
+    }
+    int failures = 0;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "%s: child failed at step %d\n", name, WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+        failures++;
+    }
+
+    vector<pair<int, int>> found;
+    {
+        IndexOptions opts;
+        opts.writeAheadLog = true;
+        BTreeIndex idx(file.c_str(), opts);
+        if (!idx.isOpen()) {
+            cerr << name << ": cannot reopen " << cfg.file << "\n";
+            return false;
+        }
+        found = idx.scan(0, cfg.keys);
+    }
+    vector<pair<int, int>> expected;
+    for (int key = 0; key < logged; key++) expected.push_back({key, key});
+    if (found != expected) failures++;
+    if (!nodesAccountedFor(file)) failures++;
+    printf("%-10s %6zu keys left  %s\n", name, found.size(), failures ? "FAILED" : "ok");
+    removeFiles(cfg.file);
+    return failures == 0;
+}
+
+// A composite fixed-width key. It has no operator<<, and instantiating
+// every member of the index for it keeps that compiling.
+struct PairKey {
+    int hi;
+    int lo;
+};
+
+struct PairLess {
+    bool operator()(const PairKey &a, const PairKey &b) const {
+        return a.hi != b.hi ? a.hi < b.hi : a.lo < b.lo;
+    }
+};
+
+template class BasicBTreeIndex<PairKey, long long, PairLess>;
+using PairIndex = BasicBTreeIndex<PairKey, long long, PairLess>;
+
+// Composite keys: every thread inserts {t, i} for its share of the keys
+// and erases every third one, then each key, a scan and a dump are checked.
+static bool runComposite(const StressConfig &cfg) {
+    const char *name = "composite";
+    removeFiles(cfg.file);
+    string file = cfg.file;
+    CreateIndexFileFile<PairKey, long long>(file.data(), 2, cfg.m);
+    int perThread = cfg.keys / cfg.threads;
+    atomic<int> failures{0};
+    size_t left = 0;
+    {
+        IndexOptions opts;
+        opts.concurrent = true;
+        PairIndex idx(file.c_str(), opts);
+        if (!idx.isOpen()) {
+            cerr << name << ": cannot open " << cfg.file << "\n";
+            return false;
+        }
+        vector<thread> workers;
+        for (int t = 0; t < cfg.threads; t++) {
+            workers.emplace_back([&, t] {
+                for (int i = 0; i < perThread; i++)
+                    if (idx.insert({t, i}, (long long)t * perThread + i) == -1) failures++;
+                for (int i = 0; i < perThread; i += 3)
+                    if (!idx.erase({t, i})) failures++;
+            });
+        }
+        for (thread &w : workers) w.join();
+
+        for (int t = 0; t < cfg.threads; t++) {
+            for (int i = 0; i < perThread; i++) {
+                long long want = i % 3 ? (long long)t * perThread + i : PairIndex::NOT_FOUND;
+                if (idx.search({t, i}) != want) failures++;
+                if (want != PairIndex::NOT_FOUND) left++;
+            }
+        }
+        vector<pair<PairKey, long long>> all = idx.scan({0, 0}, {cfg.threads, 0});
+        auto byKey = [](const pair<PairKey, long long> &a, const pair<PairKey, long long> &b) {
+            return PairLess()(a.first, b.first);
+        };
+        if (all.size() != left || !is_sorted(all.begin(), all.end(), byKey)) failures++;
+        ostringstream dump;
+        idx.display(dump);
+        if (left > 0 && dump.str().find("0x") == string::npos) failures++;
+    }
+    printf("%-10s %6zu keys left  %s\n", name, left, failures ? "FAILED" : "ok");
+    removeFiles(cfg.file);
+    return failures == 0;
+}
+
+// Appends mixed with inserts and erases in the middle, on a handle that
+// remembers its rightmost path, with the counters reset now and then. The
+// path must follow the tree, not the counters.
+static bool runStatsReset(const StressConfig &cfg) {
+    const char *name = "reset";
+    removeFiles(cfg.file);
+    string file = cfg.file;
+    CreateIndexFileFile(file.data(), 2, cfg.m);
+    map<int, int> expected;
+    int failures = 0;
+    {
+        IndexOptions opts;
+        opts.split = SplitPolicy::Append;
+        BTreeIndex idx(file.c_str(), opts);
+        if (!idx.isOpen()) {
+            cerr << name << ": cannot open " << cfg.file << "\n";
+            return false;
+        }
+        mt19937 rng(cfg.seed);
+        int top = 0;
+        for (int i = 0; i < cfg.ops; i++) {
+            int pick = rng() % 8;
+            if (pick == 0) idx.stats().reset();
+            if (pick < 4) {
+                top += 1 + rng() % 3;
+                if (idx.insert(top, i) == -1) failures++;
+                expected[top] = i;
+            } else if (pick < 6) {
+                int key = (int)(rng() % (top + 1));
+                bool had = expected.count(key);
+                if ((idx.insert(key, i) != -1) == had) failures++;
+                if (!had) expected[key] = i;
+            } else {
+                int key = (int)(rng() % (top + 1));
+                if (idx.erase(key) != (bool)expected.erase(key)) failures++;
+            }
+        }
+        for (int key = 0; key <= top; key++) {
+            auto it = expected.find(key);
+            if (idx.search(key) != (it == expected.end() ? BTreeIndex::NOT_FOUND : it->second)) failures++;
+        }
+        if (idx.scan(0, top) != vector<pair<int, int>>(expected.begin(), expected.end())) failures++;
+    }
+    printf("%-10s %6zu keys left  %s\n", name, expected.size(), failures ? "FAILED" : "ok");
+    removeFiles(cfg.file);
+    return failures == 0;
+}
+
+// Batched lookups on a mapped handle over a file whose root was never
+// written: every probe is NOT_FOUND, and the batch has to finish.
+static bool runEmpty(const StressConfig &cfg) {
+    const char *name = "empty";
+    removeFiles(cfg.file);
+    string file = cfg.file;
+    CreateIndexFileFile(file.data(), 1, cfg.m);
+    int failures = 0;
+    {
+        IndexOptions opts;
+        opts.storage = StorageMode::Mmap;
+        BTreeIndex idx(file.c_str(), opts);
+        if (!idx.isOpen()) {
+            cerr << name << ": cannot open " << cfg.file << "\n";
+            return false;
+        }
+        vector<int> ids(cfg.keys);
+        iota(ids.begin(), ids.end(), 0);
+        vector<int> refs(ids.size(), 0);
+        atomic<bool> done{false};
+        thread lookup([&] {
+            idx.multiSearch(ids, refs);
+            done = true;
+        });
+        auto deadline = chrono::steady_clock::now() + STRESS_TIMEOUT;
+        while (!done && chrono::steady_clock::now() < deadline) this_thread::sleep_for(chrono::milliseconds(10));
+        if (!done) {
+            fflush(stdout);
+            fprintf(stderr, "%s: multiSearch still running after %llds\n", name, (long long)STRESS_TIMEOUT.count());
+            _exit(1);
+        }
+        lookup.join();
+        for (int ref : refs) if (ref != BTreeIndex::NOT_FOUND) failures++;
+        if (idx.search(0) != BTreeIndex::NOT_FOUND) failures++;
+    }
+    printf("%-10s %6d keys left  %s\n", name, 0, failures ? "FAILED" : "ok");
+    removeFiles(cfg.file);
+    return failures == 0;
+}
+
+// A mapped file that cannot grow: the first insert's node lies past the
+// end of a one-node file, and with the file size capped its write fails.
+// The node must stay in the pool and reach the file once it can grow.
+static bool runMapFull(const StressConfig &cfg) {
+    const char *name = "mmap-full";
+    removeFiles(cfg.file);
+    string file = cfg.file;
+    CreateIndexFileFile(file.data(), 1, cfg.m);
+    int failures = 0;
+    {
+        IndexOptions opts;
+        opts.storage = StorageMode::Mmap;
+        BTreeIndex idx(file.c_str(), opts);
+        if (!idx.isOpen()) {
+            cerr << name << ": cannot open " << cfg.file << "\n";
+            return false;
+        }
+        rlimit saved, capped;
+        getrlimit(RLIMIT_FSIZE, &saved);
+        capped = saved;
+        capped.rlim_cur = filesystem::file_size(file);
+        auto handler = signal(SIGXFSZ, SIG_IGN);
+        setrlimit(RLIMIT_FSIZE, &capped);
+        if (idx.insert(1, 1) == -1) failures++;
+        setrlimit(RLIMIT_FSIZE, &saved);
+        signal(SIGXFSZ, handler);
+        idx.sync();
+    }
+    int left = 0;
+    {
+        IndexOptions opts;
+        opts.storage = StorageMode::Mmap;
+        BTreeIndex idx(file.c_str(), opts);
+        if (idx.search(1) == 1) left++;
+        else failures++;
+    }
+    printf("%-10s %6d keys left  %s\n", name, left, failures ? "FAILED" : "ok");
+    removeFiles(cfg.file);
+    return failures == 0;
+}
+
+static void usage() {
+    cerr << "usage: btree-stress [--threads T] [--ops N] [--keys K] [--m M] [--seed S]\n";
+}
+
+int main(int argc, char **argv) {
+    StressConfig cfg;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        auto value = [&]() -> string {
+            if (i + 1 >= argc) {
+                usage();
+                exit(2);
+            }
+            return argv[++i];
+        };
+        if (arg == "--threads") cfg.threads = stoi(value());
+        else if (arg == "--ops") cfg.ops = stoi(value());
+        else if (arg == "--keys") cfg.keys = stoi(value());
+        else if (arg == "--m") cfg.m = stoi(value());
+        else if (arg == "--seed") cfg.seed = stoul(value());
+        else {
+            usage();
+            return 2;
+        }
+    }
+    if (cfg.threads < 1 || cfg.ops < 0 || cfg.keys < cfg.threads || cfg.m < MIN_ORDER) {
+        usage();
+        return 2;
+    }
+
+    IndexOptions plain, wal, cow, mmap, deferred, sequential;
+    wal.writeAheadLog = true;
+    cow.copyOnWrite = true;
+    mmap.storage = StorageMode::Mmap;
+    deferred.deferredDeletes = true;
+    deferred.bloomFilter = true;
+    sequential.split = SplitPolicy::Sequential;
+
+    bool ok = runMode(cfg, "plain", plain);
+    ok = runMode(cfg, "wal", wal) && ok;
+    ok = runMode(cfg, "cow", cow) && ok;
+    ok = runMode(cfg, "mmap", mmap) && ok;
+    ok = runMode(cfg, "deferred", deferred) && ok;
+    ok = runMode(cfg, "sequential", sequential) && ok;
+    ok = runCrash(cfg) && ok;
+    ok = runLogFull(cfg) && ok;
+    ok = runComposite(cfg) && ok;
+    ok = runStatsReset(cfg) && ok;
+    ok = runEmpty(cfg) && ok;
+    ok = runMapFull(cfg) && ok;
+    return ok ? 0 : 1;
+}